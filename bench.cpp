@@ -3,8 +3,16 @@
 #include <string>
 #include <chrono>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstdio>
 
 #include "search.h"
+#include "uciopt.h"
 
 // These positions were copied from Obsidian
 // https://github.com/gab8192/Obsidian/blob/main/src/bench.h
@@ -39,37 +47,178 @@ const std::string BENCH_POSITIONS[] = {
         "4k3/2Rb4/3r3p/4p1p1/5p2/7P/4R1P1/6K1 w - - 0 61"
 };
 
-perft_t bench() {
-    sg::depthLimit = 12;
-    sg::nodesLimit = INT64_MAX;
-    sg::hardTimeLimit = 1000000000;
-    sg::softTimeLimit = 1000000000;
+// Reads one position per line. Anything after a semicolon (like EPD operations) is ignored.
+// ChessBoard::fromFEN treats missing or non-numeric halfmove and fullmove fields as 0
+static std::vector<std::string> readFENFile(const std::string& fileName) {
+    std::vector<std::string> fens;
+    std::ifstream file(fileName);
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find(';'));
+        if (line.find_first_not_of(" \t\r") != std::string::npos)
+            fens.push_back(line);
+    }
+    return fens;
+}
 
-    perft_t totalNodes = 0;
-    int positionsSearched = 0;
-    auto start = std::chrono::high_resolution_clock::now();
-
-    for (const std::string& fen : BENCH_POSITIONS) {
-        positionsSearched++;
-        std::cout << "-----------" << std::endl;
-        std::cout << "POSITION " << positionsSearched << std::endl;
-        std::cout << "-----------" << std::endl;
-
-        ChessBoard board = ChessBoard::fromFEN(fen);
-        sg::ThreadData result = rootSearch(board);
-        totalNodes += result.nodes;
+static double getMedian(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    const size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Gets the sample standard deviation, or 0 if there is only one value
+static double getStddev(const std::vector<double>& values) {
+    if (values.size() < 2)
+        return 0;
+    const double mean = std::accumulate(values.begin(), values.end(), 0.0) / double(values.size());
+    double sumOfSquares = 0;
+    for (double value : values)
+        sumOfSquares += (value - mean) * (value - mean);
+    return std::sqrt(sumOfSquares / double(values.size() - 1));
+}
+
+// Escapes a string so it can go between quotes in JSON
+static std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (const char c : text) {
+        if (c == '"' or c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+            escaped += buffer;
+        }
+        else {
+            escaped += c;
+        }
     }
+    return escaped;
+}
+
+perft_t bench(int depth, int threads, int hash, const std::string& fenFile, int trials) {
+    // Step 1: Apply the settings
+    // The search is single threaded for now, so threads is clamped to what the Threads option allows
+    depth = std::clamp(depth, 1, 100);
+    const int requestedThreads = threads;
+    threads = std::clamp(threads, uciopt::THREADS_MIN, uciopt::THREADS_MAX);
+    if (threads != requestedThreads)
+        std::cout << "info string bench can't use " << requestedThreads << " threads, using " << threads << " instead" << std::endl;
+    hash = std::clamp(hash, uciopt::HASH_MIN, uciopt::HASH_MAX);
+    trials = std::max(trials, 1);
 
-    sg::GLOBAL_TT.clear();
+    // Bench has its own engine, so it doesn't change the TT or options of the engine it is run from
+    uciopt::Options options;
+    options.threads = threads;
+    options.hash = hash;
+    sg::SearchContext context(options);
+    context.limits.depthLimit = depth;
+
+    // Step 2: Get the positions
+    std::vector<std::string> fens(std::begin(BENCH_POSITIONS), std::end(BENCH_POSITIONS));
+    if (!fenFile.empty())
+        fens = readFENFile(fenFile);
+    if (fens.empty()) {
+        std::cout << "info string no positions found in " << fenFile << std::endl;
+        return 0;
+    }
+
+    // Step 3: Run the trials
+    // Every trial starts with an empty TT, so every trial searches exactly the same tree
+    std::vector<perft_t> positionNodes(fens.size());
+    std::vector<std::vector<double>> positionMs(fens.size());
+    std::vector<double> trialMs;
+    std::vector<double> trialNps;
+    sg::SearchStats totalStats;
+    perft_t totalNodes = 0;
+    for (int trial = 0; trial < trials; trial++) {
+        context.tt.clear();
+        totalNodes = 0;
+        double totalMs = 0;
+        for (size_t i = 0; i < fens.size(); i++) {
+            const ChessBoard board = ChessBoard::fromFEN(fens[i]);
+            const auto start = std::chrono::high_resolution_clock::now();
+            const sg::ThreadData result = rootSearch(context, board, false);
+            const auto end = std::chrono::high_resolution_clock::now();
+            const double ms = std::chrono::duration<double, std::milli>(end - start).count();
 
-    auto end = std::chrono::high_resolution_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    auto ms = duration.count();
-    auto nps = totalNodes / ms * 1000;
+            positionNodes[i] = result.nodes;
+            positionMs[i].push_back(ms);
+            totalNodes += result.nodes;
+            totalMs += ms;
+            if (trial == 0)
+                totalStats += result.stats;
+        } // end for loop over positions
+        trialMs.push_back(totalMs);
+        trialNps.push_back(double(totalNodes) * 1000 / std::max(totalMs, 1.0));
+    } // end for loop over trials
 
+    // Step 4: Print the results for each position, using the median time over all trials
+    std::cout << std::fixed << std::setprecision(0);
+    for (size_t i = 0; i < fens.size(); i++) {
+        const double ms = getMedian(positionMs[i]);
+        std::cout << "POSITION " << i + 1 << " nodes " << positionNodes[i] << " ms " << ms
+                  << " nps " << double(positionNodes[i]) * 1000 / std::max(ms, 1.0) << " fen " << fens[i] << std::endl;
+    }
+
+    // Step 5: Print the summary
+    // The line with nodes and nps is in the same format as before, because tools like OpenBench look for it
+    const double medianMs = getMedian(trialMs);
+    const double medianNps = getMedian(trialNps);
+    const double meanNps = std::accumulate(trialNps.begin(), trialNps.end(), 0.0) / double(trials);
+    const double stddevNps = getStddev(trialNps);
     std::cout << "-------------BENCH RESULTS-------------" << std::endl;
-    std::cout << totalNodes << " nodes " << ms << " ms " <<  nps << " nps" << std::endl;
+    std::cout << totalNodes << " nodes " << medianMs << " ms " << medianNps << " nps" << std::endl;
+    if (trials > 1) {
+        std::cout << "nps over " << trials << " trials: median " << medianNps << " mean " << meanNps << " stddev " << stddevNps
+                  << " (" << std::setprecision(2) << 100 * stddevNps / meanNps << "%)" << std::setprecision(0) << std::endl;
+    }
     std::cout << "---------------------------------------" << std::endl;
+    if constexpr (sg::COLLECT_STATS)
+        totalStats.print();
+
+    // Step 6: Print the JSON summary on a single line
+    std::cout << "{\"depth\":" << depth << ",\"threads\":" << threads << ",\"hash\":" << hash << ",\"trials\":" << trials
+              << ",\"nodes\":" << totalNodes << ",\"ms_median\":" << medianMs
+              << ",\"nps_median\":" << medianNps << ",\"nps_mean\":" << meanNps
+              << ",\"nps_stddev\":" << std::setprecision(2) << stddevNps << std::setprecision(0) << ",\"nps_trials\":[";
+    for (int trial = 0; trial < trials; trial++)
+        std::cout << (trial ? "," : "") << trialNps[trial];
+    std::cout << "],\"positions\":[";
+    for (size_t i = 0; i < fens.size(); i++) {
+        const double ms = getMedian(positionMs[i]);
+        std::cout << (i ? "," : "") << "{\"fen\":\"" << escapeJSON(fens[i]) << "\",\"nodes\":" << positionNodes[i] << ",\"ms\":" << ms
+                  << ",\"nps\":" << double(positionNodes[i]) * 1000 / std::max(ms, 1.0) << "}";
+    }
+    std::cout << "]}" << std::endl;
+    std::cout << std::defaultfloat;
 
     return totalNodes;
-}
\ No newline at end of file
+}
+
+perft_t runBenchCommand(const std::vector<std::string>& args) {
+    int depth = BENCH_DEPTH_DEFAULT;
+    int threads = uciopt::THREADS_DEFAULT;
+    int hash = uciopt::HASH_DEFAULT;
+    std::string fenFile;
+    int trials = BENCH_TRIALS_DEFAULT;
+    try {
+        if (args.size() > 0)
+            depth = std::stoi(args[0]);
+        if (args.size() > 1)
+            threads = std::stoi(args[1]);
+        if (args.size() > 2)
+            hash = std::stoi(args[2]);
+        if (args.size() > 3 and args[3] != "-")
+            fenFile = args[3];
+        if (args.size() > 4)
+            trials = std::stoi(args[4]);
+    }
+    catch (const std::exception& e) {
+        std::cout << "info string usage: bench <depth> <threads> <hash> [fenfile or -] [trials]" << std::endl;
+        return 0;
+    }
+    return bench(depth, threads, hash, fenFile, trials);
+}
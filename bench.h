@@ -1,5 +1,20 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "typedefs.h"
 
-perft_t bench();
\ No newline at end of file
+constexpr int BENCH_DEPTH_DEFAULT = 12;
+constexpr int BENCH_TRIALS_DEFAULT = 1;
+
+// Searches every position to a fixed depth, trials times, and prints the nodes, time and nps of each position,
+// a summary line, and the same results as JSON on a single line
+// If fenFile is empty, the built-in bench positions are used
+// Returns the total number of nodes in one trial (this is the same in every trial)
+perft_t bench(int depth, int threads, int hash, const std::string& fenFile, int trials);
+
+// Parses "<depth> <threads> <hash> [fenfile] [trials]", where every argument is optional and a fenfile of "-"
+// means the built-in positions, and then runs bench
+// This is used by both the bench UCI command and the bench command line argument
+perft_t runBenchCommand(const std::vector<std::string>& args);
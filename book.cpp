@@ -0,0 +1,268 @@
+#include "book.h"
+#include "polyglot.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    uint64_t readBigEndian(const uint8_t* bytes, const int count) {
+        uint64_t result = 0;
+        for (int i = 0; i < count; i++)
+            result = result << 8 | bytes[i];
+        return result;
+    }
+
+    void writeBigEndian(std::ofstream& file, const uint64_t value, const int count) {
+        for (int i = count - 1; i >= 0; i--)
+            file.put(char(value >> (i * 8) & 0xff));
+    }
+
+    // Polyglot numbers squares a1, b1, ..., h8, but we number them a1, a2, ..., h8
+    uint16_t toBookSquare(const square_t square) {
+        return squares::getRank(square) * 8 + squares::getFile(square);
+    }
+
+    square_t fromBookSquare(const uint16_t bookSquare) {
+        return squares::squareFromFileRank(bookSquare & 7, bookSquare >> 3);
+    }
+
+    // Finds the legal move with the given LAN, or returns 0 if there is none
+    move_t findLegalMove(const ChessBoard& board, const std::string& lan) {
+        for (move_t move : board.getPseudoLegalMoves()) {
+            if (board.isLegal(move) and moveToLAN(move) == lan)
+                return move;
+        }
+        return 0;
+    }
+
+    std::string trim(const std::string& text) {
+        const size_t start = text.find_first_not_of(" \t\r");
+        return start == std::string::npos ? "" : text.substr(start, text.find_last_not_of(" \t\r") - start + 1);
+    }
+}
+
+zobrist_t book::getKey(const ChessBoard& board) {
+    // Step 1: Pieces. Polyglot's piece kinds go black pawn, white pawn, black knight, ..., white king
+    zobrist_t key = 0;
+    for (side_t side = 0; side < 2; side++) {
+        for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+            const int kind = 2 * piece + (side == sides::WHITE);
+            bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
+            while (remainingPieces) {
+                const square_t square = std::countr_zero(remainingPieces);
+                remainingPieces &= remainingPieces - 1;
+                key ^= polyglot::random64[polyglot::PIECE_OFFSET + 64 * kind + toBookSquare(square)];
+            }
+        }
+    }
+
+    // Step 2: Castling rights
+    const uint8_t epCastlingRights = board.getEPCastlingRights();
+    constexpr uint8_t CASTLING_RIGHTS[4] = {rights::WHITE_SC, rights::WHITE_LC, rights::BLACK_SC, rights::BLACK_LC};
+    for (int i = 0; i < 4; i++) {
+        if (epCastlingRights & CASTLING_RIGHTS[i])
+            key ^= polyglot::random64[polyglot::CASTLING_OFFSET + i];
+    }
+
+    // Step 3: En passant, which Polyglot only counts if a pawn of the side to move is next to the pawn that just moved
+    // Whether the capture is legal doesn't matter
+    const side_t stm = board.getSTM();
+    if (rights::isEPPossible(epCastlingRights)) {
+        const square_t file = rights::extractEPRights(epCastlingRights);
+        const square_t rank = stm == sides::WHITE ? 4 : 3;
+        const bitboard_t ourPawns = board.getPieceBB(pcs::PAWN) & board.getSideBB(stm);
+        const bool canCapture = (file > 0 and ourPawns & 1ULL << squares::squareFromFileRank(file - 1, rank)) or
+                                (file < 7 and ourPawns & 1ULL << squares::squareFromFileRank(file + 1, rank));
+        if (canCapture)
+            key ^= polyglot::random64[polyglot::EN_PASSANT_OFFSET + file];
+    }
+
+    // Step 4: Side to move
+    if (stm == sides::WHITE)
+        key ^= polyglot::random64[polyglot::TURN_OFFSET];
+    return key;
+}
+
+uint16_t book::encodeMove(const move_t move) {
+    const square_t from = mvs::getFrom(move);
+    square_t to = mvs::getTo(move);
+    if (mvs::isCastle(move))
+        to = squares::squareFromFileRank(mvs::isShortCastle(move) ? 7 : 0, squares::getRank(from));
+
+    const uint16_t promotion = mvs::isPromotion(move) ? mvs::getPromotedPiece(move) : 0;
+    return toBookSquare(to) | toBookSquare(from) << 6 | promotion << 12;
+}
+
+move_t book::decodeMove(const ChessBoard& board, const uint16_t bookMove) {
+    // Step 1: Decode the squares, and turn the king taking its own rook back into a castling move
+    const square_t from = fromBookSquare(bookMove >> 6 & 63);
+    square_t to = fromBookSquare(bookMove & 63);
+    const side_t stm = board.getSTM();
+    if ((board.getPieceBB(pcs::KING) & 1ULL << from) and (board.getSideBB(stm) & 1ULL << to))
+        to = squares::squareFromFileRank(squares::getFile(to) == 7 ? 6 : 2, squares::getRank(to));
+    const piece_t promotion = bookMove >> 12 & 7;
+
+    // Step 2: Find the legal move that matches
+    for (move_t move : board.getPseudoLegalMoves()) {
+        if (mvs::getFrom(move) != from or mvs::getTo(move) != to)
+            continue;
+        if ((mvs::isPromotion(move) ? mvs::getPromotedPiece(move) : 0) != promotion)
+            continue;
+        return board.isLegal(move) ? mvs::removeScore(move) : 0;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+
+book::Book::Book(const std::string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat fileStats{};
+    if (fstat(fd, &fileStats) == 0) {
+        // mmap can't map 0 bytes, but an empty file is still a valid book with no entries
+        opened = fileStats.st_size < off_t(ENTRY_BYTES);
+        if (!opened) {
+            void* mapping = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                bytes = static_cast<const uint8_t*>(mapping);
+                mappedBytes = fileStats.st_size;
+                length = mappedBytes / ENTRY_BYTES;
+                opened = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+book::Book::~Book() {
+    if (mappedBytes != 0)
+        munmap(const_cast<uint8_t*>(bytes), mappedBytes);
+}
+
+#else
+
+book::Book::Book(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file)
+        return;
+    fallback.resize(size_t(file.tellg()) / ENTRY_BYTES * ENTRY_BYTES);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(fallback.data()), std::streamsize(fallback.size()));
+    bytes = fallback.data();
+    length = fallback.size() / ENTRY_BYTES;
+    opened = true;
+}
+
+book::Book::~Book() = default;
+
+#endif
+
+bool book::Book::isOpen() const {
+    return opened;
+}
+
+book::Entry book::Book::getEntry(const size_t index) const {
+    const uint8_t* entryBytes = bytes + index * ENTRY_BYTES;
+    return {readBigEndian(entryBytes, 8), uint16_t(readBigEndian(entryBytes + 8, 2)),
+            uint16_t(readBigEndian(entryBytes + 10, 2)), uint32_t(readBigEndian(entryBytes + 12, 4))};
+}
+
+std::vector<book::Entry> book::Book::getEntries(const zobrist_t key) const {
+    // Step 1: Binary search for the first entry with a key that is at least key
+    size_t low = 0;
+    size_t high = length;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (readBigEndian(bytes + middle * ENTRY_BYTES, 8) < key)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    // Step 2: Collect the entries with this key, which are all next to each other
+    std::vector<Entry> entries;
+    for (size_t i = low; i < length; i++) {
+        const Entry entry = getEntry(i);
+        if (entry.key != key)
+            break;
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+move_t book::Book::probe(const ChessBoard& board, const bool bestMove) const {
+    // Step 1: Get the legal moves in the book, skipping any that have weight 0 or don't fit the position
+    std::vector<std::pair<move_t, uint16_t>> moves;
+    uint32_t totalWeight = 0;
+    for (const Entry& entry : getEntries(getKey(board))) {
+        const move_t move = decodeMove(board, entry.move);
+        if (move == 0 or entry.weight == 0)
+            continue;
+        moves.emplace_back(move, entry.weight);
+        totalWeight += entry.weight;
+    }
+    if (moves.empty())
+        return 0;
+
+    // Step 2: Pick one
+    if (bestMove) {
+        return std::max_element(moves.begin(), moves.end(), [](const auto& a, const auto& b) {
+            return a.second < b.second;
+        })->first;
+    }
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    uint32_t pick = std::uniform_int_distribution<uint32_t>(0, totalWeight - 1)(rng);
+    for (const auto& [move, weight] : moves) {
+        if (pick < weight)
+            return move;
+        pick -= weight;
+    }
+    return moves.back().first;
+}
+
+perft_t book::makeBook(const std::string& inFile, const std::string& outFile) {
+    std::ifstream in(inFile);
+    std::ofstream out(outFile, std::ios::binary);
+    if (!in or !out)
+        return -1;
+
+    // Step 1: Add up the weights. The map keeps them sorted by key, which is the order the book needs
+    std::map<std::pair<zobrist_t, uint16_t>, uint32_t> weights;
+    std::string line;
+    while (getline(in, line)) {
+        const size_t firstBar = line.find('|');
+        const size_t lastBar = line.rfind('|');
+        if (firstBar == std::string::npos or firstBar == lastBar)
+            continue;
+        const ChessBoard board = ChessBoard::fromFEN(trim(line.substr(0, firstBar)));
+        const move_t move = findLegalMove(board, trim(line.substr(lastBar + 1)));
+        if (move == 0) {
+            std::cout << "info string skipping line without a legal move: " << line << std::endl;
+            continue;
+        }
+        weights[{getKey(board), encodeMove(move)}]++;
+    } // end while getline
+
+    // Step 2: Write the entries, with weights capped to fit in 16 bits
+    for (const auto& [keyMove, weight] : weights) {
+        writeBigEndian(out, keyMove.first, 8);
+        writeBigEndian(out, keyMove.second, 2);
+        writeBigEndian(out, std::min(weight, uint32_t(UINT16_MAX)), 2);
+        writeBigEndian(out, 0, 4);
+    }
+    return perft_t(weights.size());
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "chessboard.h"
+
+// Opening books in the Polyglot .bin layout: a file of 16-byte big-endian entries sorted by key,
+// where each entry is a key, a move, a weight and a learn field (which we ignore)
+// Moves use the Polyglot encoding: to file in bits 0-2, to rank in bits 3-5, from file in bits 6-8,
+// from rank in bits 9-11 and the promoted piece (1 = knight ... 4 = queen) in bits 12-14.
+// Castling is encoded as the king taking its own rook, so e1g1 is stored as e1h1
+// The keys are the Polyglot keys from polyglot.h, so books made by other tools work here and the other way around
+namespace book {
+    struct Entry {
+        zobrist_t key;
+        uint16_t move;
+        uint16_t weight;
+        uint32_t learn;
+    };
+
+    constexpr size_t ENTRY_BYTES = 16;
+
+    // Gets the Polyglot key that the book entries for this position are stored under
+    zobrist_t getKey(const ChessBoard& board);
+
+    // Converts a move to the Polyglot encoding
+    uint16_t encodeMove(move_t move);
+
+    // Finds the legal move with the given Polyglot encoding, or returns 0 if there is none
+    move_t decodeMove(const ChessBoard& board, uint16_t bookMove);
+
+    // Reads a book by memory-mapping it, like packed::Reader, so opening a big book is instant
+    class Book {
+    private:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+        size_t mappedBytes = 0;
+        bool opened = false;
+        std::vector<uint8_t> fallback; // used where mmap is not available
+
+        [[nodiscard]] Entry getEntry(size_t index) const;
+
+    public:
+        explicit Book(const std::string& filename);
+        ~Book();
+        Book(const Book&) = delete;
+        Book& operator=(const Book&) = delete;
+
+        // Returns false if the file could not be opened
+        [[nodiscard]] bool isOpen() const;
+
+        // Gets the number of entries
+        [[nodiscard]] inline size_t size() const {
+            return length;
+        }
+
+        // Gets every entry with this key, by binary searching for the first one
+        [[nodiscard]] std::vector<Entry> getEntries(zobrist_t key) const;
+
+        // Picks a legal book move for the position, or returns 0 if there is none
+        // If bestMove is true, this is the move with the highest weight
+        // Otherwise, every move is picked with probability proportional to its weight
+        [[nodiscard]] move_t probe(const ChessBoard& board, bool bestMove) const;
+    };
+
+    // Makes a book from lines like "<fen> | <score> | <bestmove>", which is the output of evalbatch
+    // Every line adds 1 to the weight of its move, so positions that appear more often get the same move more often
+    // Returns the number of entries written, or -1 if a file can't be opened
+    perft_t makeBook(const std::string& inFile, const std::string& outFile);
+}
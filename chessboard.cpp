@@ -3,6 +3,7 @@
 #include <cassert>
 #include <iostream>
 #include <bit>
+#include <algorithm>
 
 #include "chessboard.h"
 #include "logarithm.h"
@@ -17,6 +18,9 @@ const static std::string emptySpaceChars = "/12345678";
 const static std::string fileChars = "abcdefgh";
 const static std::string rankChars = "12345678";
 
+// Piece values used by isSEEAtLeast
+constexpr static std::array<int, 6> SEE_VALUES = {100, 300, 300, 500, 900, 0};
+
 std::string moveToLAN(move_t move) {
     square_t from = mvs::getFrom(move);
     square_t to = mvs::getTo(move);
@@ -172,6 +176,53 @@ ChessBoard ChessBoard::fromFEN(const std::string& fen) {
     return ChessBoard(fen);
 }
 
+ChessBoard ChessBoard::fromPacked(const PackedBoard& packedBoard) {
+    ChessBoard board = startpos();
+
+    // Step 1: Fill in pieceTypes and colors
+    board.pieceTypes = {0,0,0,0,0,0};
+    board.colors = {0,0};
+    bitboard_t remainingSquares = packedBoard.occupancy;
+    for (int i = 0; remainingSquares; i++) {
+        const bitboard_t squareBB = remainingSquares & -remainingSquares;
+        remainingSquares -= squareBB;
+        const uint8_t nibble = packedBoard.pieces[i / 2] >> (i % 2 * 4) & 0xf;
+        board.pieceTypes[nibble & 7] |= squareBB;
+        board.colors[nibble >> 3] |= squareBB;
+    }
+
+    // Step 2: Fill in everything else
+    board.epCastlingRights = packedBoard.epCastlingRights;
+    board.stm = packedBoard.stm;
+    board.halfmove = packedBoard.halfmove;
+    board.fullmove = packedBoard.fullmove;
+    board.zobristCode = board.calcZobristCode();
+    board.pawnKey = board.calcPawnKey();
+    board.updatePieceGivingCheck();
+    return board;
+}
+
+PackedBoard ChessBoard::toPacked() const {
+    PackedBoard packedBoard{};
+    packedBoard.occupancy = colors[sides::WHITE] | colors[sides::BLACK];
+    assert(std::popcount(packedBoard.occupancy) <= 32);
+
+    bitboard_t remainingSquares = packedBoard.occupancy;
+    for (int i = 0; remainingSquares; i++) {
+        const bitboard_t squareBB = remainingSquares & -remainingSquares;
+        remainingSquares -= squareBB;
+        const uint8_t side = colors[sides::BLACK] & squareBB ? sides::BLACK : sides::WHITE;
+        const uint8_t nibble = side << 3 | getPieceAt(std::countr_zero(squareBB));
+        packedBoard.pieces[i / 2] |= nibble << (i % 2 * 4);
+    }
+
+    packedBoard.epCastlingRights = epCastlingRights;
+    packedBoard.stm = stm;
+    packedBoard.halfmove = uint8_t(std::min(halfmove, uint16_t(255)));
+    packedBoard.fullmove = fullmove;
+    return packedBoard;
+}
+
 ChessBoard ChessBoard::startpos() {
     return ChessBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
 }
@@ -736,6 +787,67 @@ bool ChessBoard::isLegal(move_t move) const {
     return diff;
 }
 
+[[nodiscard]] bool ChessBoard::isSEEAtLeast(move_t move, int threshold) const {
+    // Step 1: Castling never loses material
+    if (mvs::isCastle(move))
+        return threshold <= 0;
+
+    // Step 2: Check the material we gain with the move itself
+    const square_t to = mvs::getTo(move);
+    const bitboard_t fromBB = 1ULL << mvs::getFrom(move);
+    piece_t nextVictim = mvs::getPiece(move);
+    int swap = (mvs::isCapture(move) ? SEE_VALUES[mvs::getCapturedPiece(move)] : 0) - threshold;
+    if (mvs::isPromotion(move)) {
+        nextVictim = mvs::getPromotedPiece(move);
+        swap += SEE_VALUES[nextVictim] - SEE_VALUES[pcs::PAWN];
+    }
+    if (swap < 0)
+        return false;
+
+    // Step 3: Check if we still reach the threshold when we lose the moved piece
+    swap = SEE_VALUES[nextVictim] - swap;
+    if (swap <= 0)
+        return true;
+
+    // Step 4: Let both sides recapture with their least valuable piece until one of them stops
+    // Sliders behind other attackers are found automatically because attacks are recalculated with the new occupancy
+    bitboard_t occupied = (colors[0] ^ colors[1]) & ~fromBB;
+    if (mvs::isEP(move))
+        occupied &= ~(1ULL << squares::squareFromFileRank(squares::getFile(to), squares::getRank(mvs::getFrom(move))));
+    side_t side = stm;
+    bool result = true;
+    while (true) {
+        side ^= 1;
+        piece_t attacker = pcs::KING + 1;
+        bitboard_t attackers = 0;
+        for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+            attackers = getAttackedSquares(to, piece, occupied, side ^ 1) & pieceTypes[piece] & colors[side] & occupied;
+            if (attackers) {
+                attacker = piece;
+                break;
+            }
+        } // end for loop over piece
+        if (attackers == 0)
+            break;
+
+        result = !result;
+        // The king can only recapture if the other side has nothing left that attacks the square
+        if (attacker == pcs::KING) {
+            for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+                if (getAttackedSquares(to, piece, occupied, side) & pieceTypes[piece] & colors[side ^ 1] & occupied)
+                    return !result;
+            }
+            return result;
+        }
+
+        swap = SEE_VALUES[attacker] - swap;
+        if (swap < int(result))
+            break;
+        occupied ^= attackers & -attackers;
+    } // end while loop
+    return result;
+} // end isSEEAtLeast method
+
 void ChessBoard::updatePieceGivingCheck() {
     const side_t nstm = stm ^ 1;
     const bitboard_t allPieces = colors[sides::WHITE] ^ colors[sides::BLACK];
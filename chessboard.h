@@ -2,6 +2,7 @@
 #include "typedefs.h"
 #include "flags.h"
 #include "movelist.h"
+#include "packedboard.h"
 
 #include <array>
 #include <string>
@@ -32,6 +33,12 @@ public:
     // Static factory method that returns a position initialized to the specific FEN
     static ChessBoard fromFEN(const std::string& fen);
 
+    // Static factory method that unpacks a position from a training data file (see packedboard.h)
+    static ChessBoard fromPacked(const PackedBoard& packedBoard);
+
+    // Packs the position into 32 bytes. The result and score are left at 0
+    [[nodiscard]] PackedBoard toPacked() const;
+
     // Gives the position in FEN notation
     [[nodiscard]] std::string toFEN() const;
 
@@ -97,6 +104,11 @@ public:
     // The behavior is undefined if the move isn't pseudolegal
     [[nodiscard]] bool isGoodSEE(move_t move) const;
 
+    // Returns true if the static exchange evaluation of the move is at least the threshold (in centipawns)
+    // Unlike isGoodSEE, this does a full swap, so it can be used with thresholds other than 0
+    // The behavior is undefined if the move isn't pseudolegal
+    [[nodiscard]] bool isSEEAtLeast(move_t move, int threshold) const;
+
     // Sets the pieceGivingCheck field to whichever square is the piece giving check (if any)
     void updatePieceGivingCheck();
 
@@ -145,6 +157,11 @@ public:
         return halfmove;
     }
 
+    // Gets the en passant and castling rights, see the rights namespace in flags.h
+    [[nodiscard]] inline uint8_t getEPCastlingRights() const {
+        return epCastlingRights;
+    }
+
     [[nodiscard]] inline bitboard_t getPieceBB(piece_t piece) const {
         return pieceTypes[piece];
     }
@@ -1,6 +1,8 @@
 #include "flags.h"
 #include "corrhist.h"
 
+#include <algorithm>
+
 // Corrections are stored as an exponentially weighted moving average
 // The value stored in the table is 256 times the average diff for that pawn hash
 // This is because otherwise everything would just round off to 0 all the time
@@ -10,7 +12,7 @@ PawnCorrhist::PawnCorrhist() {
 }
 
 void PawnCorrhist::clear() {
-    table = std::vector<int32_t>(1 << 20);
+    std::fill(table.begin(), table.end(), 0);
 }
 
 void PawnCorrhist::put(const zobrist_t pawnKey, const eval_t score, const eval_t staticEval, const side_t stm) {
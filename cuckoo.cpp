@@ -0,0 +1,87 @@
+#include "cuckoo.h"
+
+#include <array>
+#include <utility>
+#include <cstdlib>
+#include <algorithm>
+
+#include "flags.h"
+#include "zobrist.h"
+
+struct CuckooTables {
+    std::array<zobrist_t, cuckoo::TABLE_SIZE> keyDiffs{};
+    std::array<move_t, cuckoo::TABLE_SIZE> moves{};
+};
+
+// Returns true if the piece could move from square1 to square2 on an empty board
+// We don't use the attack tables here because they might not be initialized yet when this runs
+bool canPieceMoveBetween(piece_t piece, square_t square1, square_t square2) {
+    const int fileDiff = std::abs(squares::getFile(square1) - squares::getFile(square2));
+    const int rankDiff = std::abs(squares::getRank(square1) - squares::getRank(square2));
+    const bool isDiagonal = fileDiff == rankDiff and fileDiff != 0;
+    const bool isStraight = (fileDiff == 0) != (rankDiff == 0);
+
+    switch (piece) {
+        case pcs::KNIGHT:
+            return fileDiff * rankDiff == 2;
+        case pcs::BISHOP:
+            return isDiagonal;
+        case pcs::ROOK:
+            return isStraight;
+        case pcs::QUEEN:
+            return isDiagonal or isStraight;
+        case pcs::KING:
+            return std::max(fileDiff, rankDiff) == 1;
+        default:
+            return false;
+    }
+}
+
+CuckooTables initCuckooTables() {
+    CuckooTables tables;
+    for (piece_t piece = pcs::KNIGHT; piece <= pcs::KING; piece++) {
+        for (side_t side = 0; side < 2; side++) {
+            for (square_t square1 = 0; square1 < 64; square1++) {
+                for (square_t square2 = square1 + 1; square2 < 64; square2++) {
+                    if (!canPieceMoveBetween(piece, square1, square2))
+                        continue;
+
+                    zobrist_t keyDiff = zb::getPieceZobrist(square1, side, piece) ^ zb::getPieceZobrist(square2, side, piece) ^ zb::stmZobrist;
+                    move_t move = mvs::constructMove(square1, square2, flags::QUIET_FLAG, piece, 0);
+
+                    // Cuckoo insertion: keep kicking out the entry in our slot into its other slot until we find an empty one
+                    size_t index = cuckoo::h1(keyDiff);
+                    while (true) {
+                        std::swap(tables.keyDiffs[index], keyDiff);
+                        std::swap(tables.moves[index], move);
+                        if (move == 0)
+                            break;
+                        index = (index == cuckoo::h1(keyDiff)) ? cuckoo::h2(keyDiff) : cuckoo::h1(keyDiff);
+                    } // end while true
+                } // end for loop over square2
+            } // end for loop over square1
+        } // end for loop over side
+    } // end for loop over piece
+    return tables;
+} // end initCuckooTables function
+
+const static CuckooTables CUCKOO_TABLES = initCuckooTables();
+
+move_t cuckoo::getMove(const zobrist_t keyDiff) {
+    size_t index = h1(keyDiff);
+    if (CUCKOO_TABLES.keyDiffs[index] == keyDiff)
+        return CUCKOO_TABLES.moves[index];
+    index = h2(keyDiff);
+    if (CUCKOO_TABLES.keyDiffs[index] == keyDiff)
+        return CUCKOO_TABLES.moves[index];
+    return 0;
+}
+
+int cuckoo::countMoves() {
+    int count = 0;
+    for (move_t move : CUCKOO_TABLES.moves) {
+        if (move != 0)
+            count++;
+    }
+    return count;
+}
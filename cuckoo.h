@@ -0,0 +1,27 @@
+#pragma once
+
+#include "typedefs.h"
+
+// Cuckoo tables of every reversible piece move, used for upcoming repetition detection
+// See Marcel van Kervinck's paper "The design of a cuckoo hash table for repetition detection"
+// For every reversible move, the table stores the difference it makes to the zobrist code (including the stm flip)
+// So if the difference between the current zobrist code and an earlier one is in the table,
+// the side to move might have a move that repeats the earlier position
+namespace cuckoo {
+    constexpr size_t TABLE_SIZE = 8192;
+
+    inline size_t h1(zobrist_t keyDiff) {
+        return keyDiff & (TABLE_SIZE - 1);
+    }
+
+    inline size_t h2(zobrist_t keyDiff) {
+        return keyDiff >> 16 & (TABLE_SIZE - 1);
+    }
+
+    // Returns the move (without side information) that changes the zobrist code by keyDiff
+    // Returns 0 if no reversible move changes the zobrist code by keyDiff
+    move_t getMove(zobrist_t keyDiff);
+
+    // Returns how many moves are stored in the tables. This should always be 3668.
+    int countMoves();
+}
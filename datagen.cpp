@@ -0,0 +1,250 @@
+#include "datagen.h"
+
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "search.h"
+#include "searchglobals.h"
+#include "uciopt.h"
+#include "packedboard.h"
+
+// Without a book, every game starts with this many random moves
+constexpr int RANDOM_OPENING_PLIES = 8;
+// Games where the first search is further from 0 than this are thrown away, since the opening was too unbalanced
+constexpr int MAX_OPENING_SCORE = 1000;
+// A game is adjudicated as a win when the score is at least this for this many plies in a row
+constexpr int WIN_ADJUDICATION_SCORE = 2000;
+constexpr int WIN_ADJUDICATION_PLIES = 4;
+// After DRAW_ADJUDICATION_MIN_PLY, a game is adjudicated as a draw when the score is within this for this many plies
+constexpr int DRAW_ADJUDICATION_SCORE = 10;
+constexpr int DRAW_ADJUDICATION_PLIES = 8;
+constexpr int DRAW_ADJUDICATION_MIN_PLY = 60;
+// Games that get this long are drawn
+constexpr int MAX_GAME_PLIES = 400;
+// A thread gives up after this many openings in a row that couldn't be played, since the book is probably unusable
+constexpr int MAX_OPENING_ATTEMPTS = 1000;
+
+namespace {
+    MoveList getLegalMoves(const ChessBoard& board) {
+        MoveList legalMoves;
+        for (move_t move : board.getPseudoLegalMoves()) {
+            if (board.isLegal(move))
+                legalMoves.push_back(move);
+        }
+        return legalMoves;
+    }
+
+    // Reads the positions of a book, leaving out the ones where the game is already over
+    std::vector<PackedBoard> readBookFile(const std::string& bookFile) {
+        std::vector<PackedBoard> boards;
+        std::ifstream file(bookFile);
+        std::string line;
+        int skipped = 0;
+        while (getline(file, line)) {
+            if (line.empty())
+                continue;
+            const ChessBoard board = ChessBoard::fromFEN(line.substr(0, line.find('[')));
+            if (getLegalMoves(board).size != 0)
+                boards.push_back(board.toPacked());
+            else
+                skipped++;
+        }
+        if (skipped > 0)
+            std::cout << "info string skipped " << skipped << " positions without legal moves in " << bookFile << std::endl;
+        return boards;
+    }
+
+    // Gets the starting position of a game, or returns false if the random moves ran into a finished game
+    bool getOpening(const std::vector<PackedBoard>& book, std::mt19937_64& rng, ChessBoard& board) {
+        if (!book.empty()) {
+            board = ChessBoard::fromPacked(book[rng() % book.size()]);
+            return true;
+        }
+
+        board = ChessBoard::startpos();
+        for (int ply = 0; ply < RANDOM_OPENING_PLIES; ply++) {
+            const MoveList legalMoves = getLegalMoves(board);
+            if (legalMoves.size == 0)
+                return false;
+            board.makemove(legalMoves.at(rng() % legalMoves.size));
+        }
+        return getLegalMoves(board).size != 0;
+    }
+
+    // Plays one game, and fills positions with the positions to write
+    // Returns false if the game should be thrown away
+    bool playGame(sg::SearchContext& context, ChessBoard board, std::vector<PackedBoard>& positions) {
+        // Step 1: Start with an empty TT and repetition tables, like after ucinewgame
+        context.tt.clear();
+        context.repetitionTables[sides::WHITE].clear();
+        context.repetitionTables[sides::BLACK].clear();
+        context.repetitionTables[board.getSTM()].insert(board.getZobristCode());
+        positions.clear();
+
+        // Step 2: Play moves until the game is over or adjudicated
+        uint8_t result = packed::results::DRAW;
+        int winPlies = 0;
+        int drawPlies = 0;
+        for (int ply = 0; ; ply++) {
+            // Step 2.1: Check if the game is over
+            if (getLegalMoves(board).size == 0) {
+                if (board.isInCheck())
+                    result = board.getSTM() == sides::WHITE ? packed::results::BLACK_WIN : packed::results::WHITE_WIN;
+                break;
+            }
+            if (board.getHalfmove() >= 100 or ply >= MAX_GAME_PLIES or
+            std::popcount(board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK)) == 2)
+                break;
+
+            // Step 2.2: Search
+            const sg::ThreadData searchResult = rootSearch(context, board, false);
+            const eval_t score = searchResult.rootScore;
+            const move_t bestMove = searchResult.rootBestMove;
+            const eval_t whiteScore = board.getSTM() == sides::WHITE ? score : eval_t(-score);
+            if (ply == 0 and std::abs(score) > MAX_OPENING_SCORE)
+                return false;
+
+            // Step 2.3: Adjudicate
+            winPlies = std::abs(score) >= WIN_ADJUDICATION_SCORE ? winPlies + 1 : 0;
+            drawPlies = ply >= DRAW_ADJUDICATION_MIN_PLY and std::abs(score) <= DRAW_ADJUDICATION_SCORE ? drawPlies + 1 : 0;
+            if (winPlies >= WIN_ADJUDICATION_PLIES) {
+                result = whiteScore > 0 ? packed::results::WHITE_WIN : packed::results::BLACK_WIN;
+                break;
+            }
+            if (drawPlies >= DRAW_ADJUDICATION_PLIES)
+                break;
+
+            // Step 2.4: Keep the position if it is quiet, since the eval is only used in quiet positions
+            if (!board.isInCheck() and !mvs::isCapture(bestMove) and !mvs::isPromotion(bestMove) and !sg::isMateScore(score)) {
+                PackedBoard packedBoard = board.toPacked();
+                packedBoard.score = whiteScore;
+                positions.push_back(packedBoard);
+            }
+
+            // Step 2.5: Make the move, keeping track of repetitions the same way the position command does
+            if (mvs::isIrreversible(bestMove)) {
+                context.repetitionTables[sides::WHITE].clear();
+                context.repetitionTables[sides::BLACK].clear();
+            }
+            board.makemove(bestMove);
+            if (context.repetitionTables[board.getSTM()].isRepeated(board.getZobristCode()))
+                break;
+            context.repetitionTables[board.getSTM()].insert(board.getZobristCode());
+        } // end for loop over plies
+
+        // Step 3: Now that we know the result, put it in every position
+        for (PackedBoard& packedBoard : positions)
+            packedBoard.result = result;
+        return true;
+    }
+}
+
+perft_t datagen(const std::string& outFile, int games, int threads, int nodes, const std::string& bookFile, int hash,
+                uciopt::Options options) {
+    // Step 1: Apply the settings
+    games = std::max(games, 1);
+    threads = std::max(threads, 1);
+    nodes = std::max(nodes, 1);
+    options.hash = std::clamp(hash, uciopt::HASH_MIN, uciopt::HASH_MAX);
+
+    // Step 2: Open the files
+    const std::vector<PackedBoard> book = bookFile.empty() ? std::vector<PackedBoard>() : readBookFile(bookFile);
+    if (!bookFile.empty() and book.empty()) {
+        std::cout << "info string no positions found in " << bookFile << std::endl;
+        return 0;
+    }
+    std::ofstream file(outFile, std::ios::binary | std::ios::app);
+    if (!file) {
+        std::cout << "info string could not open " << outFile << std::endl;
+        return 0;
+    }
+
+    // Step 3: Play the games
+    // Every thread takes the next game that nobody has started yet, until there are none left
+    std::atomic<int> nextGame = 0;
+    std::atomic<int> gamesPlayed = 0;
+    std::atomic<perft_t> positionsWritten = 0;
+    std::atomic<bool> stop = false;
+    std::mutex fileMutex;
+    const auto start = std::chrono::steady_clock::now();
+    const auto getPositionsPerSecond = [&] {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return perft_t(double(positionsWritten) / std::max(seconds, 0.001));
+    };
+
+    const auto worker = [&](const int threadIndex) {
+        // Every thread plays its games with its own engine
+        sg::SearchContext context(options);
+        context.limits.nodesLimit = nodes;
+        context.limits.hardNodesLimit = nodes;
+
+        std::mt19937_64 rng(std::random_device{}() + threadIndex);
+        std::vector<PackedBoard> positions;
+        ChessBoard board = ChessBoard::startpos();
+        while (!stop and nextGame++ < games) {
+            int attempts = 1;
+            while (attempts <= MAX_OPENING_ATTEMPTS and (!getOpening(book, rng, board) or !playGame(context, board, positions)))
+                attempts++;
+            if (attempts > MAX_OPENING_ATTEMPTS) {
+                if (!stop.exchange(true)) {
+                    std::cout << "info string datagen stopped: " << MAX_OPENING_ATTEMPTS
+                              << " openings in a row were finished or too unbalanced to play" << std::endl;
+                }
+                break;
+            }
+
+            std::lock_guard<std::mutex> lock(fileMutex);
+            file.write(reinterpret_cast<const char*>(positions.data()), std::streamsize(positions.size() * sizeof(PackedBoard)));
+            positionsWritten += perft_t(positions.size());
+            if (++gamesPlayed % 10 == 0) {
+                std::cout << "info string datagen games " << gamesPlayed << " positions " << positionsWritten
+                          << " positions/s " << getPositionsPerSecond() << std::endl;
+            }
+        } // end while there are games left
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(worker, i);
+    for (std::thread& thread : workers)
+        thread.join();
+
+    // Step 4: Print the summary
+    std::cout << "info string datagen finished " << gamesPlayed << " games, " << positionsWritten << " positions, "
+              << getPositionsPerSecond() << " positions/s" << std::endl;
+    return positionsWritten;
+}
+
+perft_t runDatagenCommand(const std::vector<std::string>& args, const uciopt::Options& options) {
+    std::string outFile;
+    int games = 0;
+    int threads = 1;
+    int nodes = DATAGEN_NODES_DEFAULT;
+    std::string bookFile;
+    int hash = DATAGEN_HASH_DEFAULT;
+    try {
+        if (args.size() < 3)
+            throw std::invalid_argument("not enough arguments");
+        outFile = args[0];
+        games = std::stoi(args[1]);
+        threads = std::stoi(args[2]);
+        if (args.size() > 3)
+            nodes = std::stoi(args[3]);
+        if (args.size() > 4 and args[4] != "-")
+            bookFile = args[4];
+        if (args.size() > 5)
+            hash = std::stoi(args[5]);
+    }
+    catch (const std::exception& e) {
+        std::cout << "info string usage: datagen <outfile> <games> <threads> [nodes] [bookfile or -] [hash]" << std::endl;
+        return 0;
+    }
+    return datagen(outFile, games, threads, nodes, bookFile, hash, options);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "uciopt.h"
+
+constexpr int DATAGEN_NODES_DEFAULT = 5000;
+constexpr int DATAGEN_HASH_DEFAULT = 8;
+
+// Plays games of self-play with a fixed number of nodes per move, each game on its own thread with its own TT,
+// and appends the quiet positions of each game to outFile as packed positions (see packedboard.h),
+// with the search score and the game result
+// Games start from a random book position if bookFile is not empty, and from random moves otherwise
+// Every thread's engine gets options, with the hash size changed to hash
+// Returns the number of positions written
+perft_t datagen(const std::string& outFile, int games, int threads, int nodes, const std::string& bookFile, int hash,
+                uciopt::Options options = {});
+
+// Parses "<outfile> <games> <threads> [nodes] [bookfile or -] [hash]" and then runs datagen
+// This is used by both the datagen UCI command and the datagen command line argument
+perft_t runDatagenCommand(const std::vector<std::string>& args, const uciopt::Options& options = {});
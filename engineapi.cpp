@@ -0,0 +1,167 @@
+#include "engineapi.h"
+
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <utility>
+#include <vector>
+
+#include "chessboard.h"
+#include "search.h"
+#include "searchglobals.h"
+#include "repetitiontable.h"
+#include "tt.h"
+#include "uci.h"
+#include "uciopt.h"
+#include "hce.h"
+
+struct AmethystEngine {
+    sg::SearchContext context; // the options, TT and repetition tables
+    ChessBoard position = ChessBoard::startpos();
+    sg::ThreadData threadData;
+
+    explicit AmethystEngine(const uciopt::Options& options) : context(options) {}
+};
+
+namespace {
+    // Finds the legal move with the given LAN, or returns 0 if there is none
+    move_t findLegalMove(const ChessBoard& board, const std::string& lan) {
+        for (move_t move : board.getPseudoLegalMoves()) {
+            if (board.isLegal(move) and moveToLAN(move) == lan)
+                return move;
+        }
+        return 0;
+    }
+
+    void copyMove(char destination[6], const std::string& lan) {
+        const size_t length = std::min(lan.size(), size_t(5));
+        std::copy_n(lan.begin(), length, destination);
+        destination[length] = '\0';
+    }
+
+    // Follows the TT moves from the position after the best move, for as long as they are legal and don't repeat
+    void fillPV(const TT& tt, const ChessBoard& root, const move_t bestMove, AmethystSearchResult& result) {
+        constexpr int MAX_PV_LENGTH = sizeof(result.pv) / sizeof(result.pv[0]);
+        result.pvLength = 0;
+        if (bestMove == 0)
+            return;
+
+        ChessBoard board = root;
+        std::vector<zobrist_t> visited = {board.getZobristCode()};
+        move_t move = bestMove;
+        while (true) {
+            copyMove(result.pv[result.pvLength++], moveToLAN(move));
+            board.makemove(move);
+            if (result.pvLength == MAX_PV_LENGTH or std::find(visited.begin(), visited.end(), board.getZobristCode()) != visited.end())
+                return;
+            visited.push_back(board.getZobristCode());
+
+            const TTEntry entry = tt.get(board.getZobristCode());
+            if (entry.ttMove == 0)
+                return;
+            move = findLegalMove(board, moveToLAN(entry.ttMove));
+            if (move == 0)
+                return;
+        } // end while true
+    }
+}
+
+AmethystEngine* amethystCreate(const int hashMB) {
+    uciopt::Options options;
+    options.hash = std::clamp(hashMB, uciopt::HASH_MIN, uciopt::HASH_MAX);
+    return new AmethystEngine(options);
+}
+
+void amethystDestroy(AmethystEngine* engine) {
+    delete engine;
+}
+
+int amethystSetOption(AmethystEngine* engine, const char* name, const char* value) {
+    return setOption(engine->context, name, value, false);
+}
+
+void amethystNewGame(AmethystEngine* engine) {
+    engine->context.tt.clear();
+}
+
+int amethystSetPosition(AmethystEngine* engine, const char* fen, const char* moves) {
+    // Step 1: Set up the position and repetition tables on the side, so nothing changes if a move is illegal
+    ChessBoard position = fen == nullptr ? ChessBoard::startpos() : ChessBoard::fromFEN(fen);
+    std::array<RepetitionTable, 2> repetitionTables{};
+
+    // Step 2: Make the moves, keeping track of repetitions the same way the position command does
+    std::stringstream ss(moves == nullptr ? "" : moves);
+    std::string word;
+    while (ss >> word) {
+        const move_t move = findLegalMove(position, word);
+        if (move == 0)
+            return 0;
+        if (mvs::isIrreversible(move)) {
+            repetitionTables[sides::WHITE].clear();
+            repetitionTables[sides::BLACK].clear();
+        }
+        else {
+            repetitionTables[position.getSTM()].insert(position.getZobristCode());
+        }
+        position.makemove(move);
+    } // end while ss >> word
+    repetitionTables[position.getSTM()].insert(position.getZobristCode());
+
+    // Step 3: Give them to the engine
+    engine->position = position;
+    engine->context.repetitionTables = std::move(repetitionTables);
+    return 1;
+}
+
+int amethystSearch(AmethystEngine* engine, const AmethystLimits* limits, AmethystSearchResult* result) {
+    if (limits->depth <= 0 and limits->nodes <= 0 and limits->movetimeMs <= 0 and limits->timeMs <= 0)
+        return 0;
+
+    // Step 1: Set the limits
+    sg::SearchContext& context = engine->context;
+    context.limits = sg::SearchLimits();
+    if (limits->depth > 0)
+        context.limits.depthLimit = std::min(limits->depth, 100);
+    if (limits->nodes > 0) {
+        context.limits.nodesLimit = limits->nodes;
+        context.limits.hardNodesLimit = limits->nodes;
+    }
+    if (limits->timeMs > 0)
+        context.setClockLimits(limits->timeMs, limits->incMs);
+    if (limits->movetimeMs > 0) {
+        context.limits.softTimeLimit = std::min(context.limits.softTimeLimit, limits->movetimeMs);
+        context.limits.hardTimeLimit = std::min(context.limits.hardTimeLimit, limits->movetimeMs);
+    }
+
+    // Step 2: Search
+    sg::ThreadData& threadData = engine->threadData;
+    threadData.clear();
+    rootSearch(context, threadData, engine->position, false);
+
+    // Step 3: Fill in the result
+    copyMove(result->bestMove, threadData.rootBestMove == 0 ? "0000" : moveToLAN(threadData.rootBestMove));
+    result->score = threadData.rootScore;
+    result->mate = sg::isMateScore(threadData.rootScore) ? sg::getMateInMoves(threadData.rootScore) : 0;
+    result->depth = threadData.rootDepth;
+    result->nodes = threadData.nodes;
+    fillPV(context.tt, engine->position, threadData.rootBestMove, *result);
+    return 1;
+}
+
+int amethystStaticEval(const AmethystEngine* engine) {
+    return hce::getStaticEval(engine->position);
+}
+
+int amethystLegalMoves(const AmethystEngine* engine, char moves[][6], const int maxMoves) {
+    int count = 0;
+    for (move_t move : engine->position.getPseudoLegalMoves()) {
+        if (!engine->position.isLegal(move))
+            continue;
+        if (count < maxMoves)
+            copyMove(moves[count], moveToLAN(move));
+        count++;
+    }
+    return count;
+}
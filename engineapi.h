@@ -0,0 +1,75 @@
+/*
+ * C API for embedding the engine in another program, compiled into the amethyst_engine shared library.
+ *
+ * Every engine instance has its own position, TT, repetition tables, search thread data and UCI options,
+ * so one process can host many independent engines.
+ * Different instances can be used from different threads at the same time,
+ * but one instance must only be used by one thread at a time.
+ * The only state shared between instances is the Syzygy tablebases (the SyzygyPath option), which are loaded once per process.
+ *
+ * Moves are in long algebraic notation, like "e2e4" or "e7e8q".
+ * Scores are in centipawns from the point of view of the side to move.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct AmethystEngine AmethystEngine;
+
+// The search stops when any of the limits that are not 0 is hit. At least one of them must not be 0
+typedef struct AmethystLimits {
+    int depth;
+    int64_t nodes;
+    int movetimeMs;
+    // The clock of the side to move, like wtime/winc or btime/binc in UCI
+    int timeMs;
+    int incMs;
+} AmethystLimits;
+
+typedef struct AmethystSearchResult {
+    char bestMove[6]; // "0000" if there are no legal moves
+    int score;
+    int mate; // if this is not 0, the side to move mates in this many moves (or gets mated, if it is negative)
+    int depth;
+    int64_t nodes;
+    int pvLength;
+    char pv[64][6]; // the first pvLength moves are the principal variation, starting with bestMove
+} AmethystSearchResult;
+
+// Creates an engine at the starting position, with a TT of hashMB megabytes (clamped to the range of the Hash option)
+// The engine must be freed with amethystDestroy
+AmethystEngine* amethystCreate(int hashMB);
+
+void amethystDestroy(AmethystEngine* engine);
+
+// Sets a UCI option, like amethystSetOption(engine, "Hash", "64")
+// Changing Hash clears the TT. Returns 0 if there is no option with that name, and 1 otherwise
+int amethystSetOption(AmethystEngine* engine, const char* name, const char* value);
+
+// Clears the TT, like ucinewgame
+void amethystNewGame(AmethystEngine* engine);
+
+// Sets the position to fen (or the starting position if fen is NULL), followed by the space-separated moves
+// in moves (which can be NULL), like the position command
+// Returns 0 and leaves the position unchanged if a move is illegal, and 1 otherwise
+int amethystSetPosition(AmethystEngine* engine, const char* fen, const char* moves);
+
+// Searches the current position, and fills result
+// Returns 0 if none of the limits are set, and 1 otherwise
+int amethystSearch(AmethystEngine* engine, const AmethystLimits* limits, AmethystSearchResult* result);
+
+// Gets the static eval of the current position
+int amethystStaticEval(const AmethystEngine* engine);
+
+// Writes the legal moves of the current position to moves, up to maxMoves of them
+// Returns the number of legal moves, which can be more than maxMoves
+int amethystLegalMoves(const AmethystEngine* engine, char moves[][6], int maxMoves);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,159 @@
+#include "evalbatch.h"
+
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "search.h"
+#include "searchglobals.h"
+#include "uciopt.h"
+#include "hce.h"
+
+namespace {
+    // Gets the FEN from a line of the input file, or an empty string if there is none
+    std::string getFEN(const std::string& line) {
+        std::string fen = line.substr(0, line.find('['));
+        fen.erase(fen.find_last_not_of(" \t\r") + 1);
+        fen.erase(0, fen.find_first_not_of(" \t"));
+        return fen;
+    }
+
+    std::string evaluate(sg::SearchContext& context, sg::ThreadData& threadData, const std::string& fen, const bool search) {
+        const ChessBoard board = ChessBoard::fromFEN(fen);
+        if (!search)
+            return fen + " | " + std::to_string(hce::getStaticEval(board)) + " | 0000";
+
+        // Every position starts from scratch, like the first search after ucinewgame
+        context.tt.clear();
+        context.repetitionTables[sides::WHITE].clear();
+        context.repetitionTables[sides::BLACK].clear();
+        context.repetitionTables[board.getSTM()].insert(board.getZobristCode());
+        threadData.clear();
+
+        rootSearch(context, threadData, board, false);
+        const std::string bestMove = threadData.rootBestMove == 0 ? "0000" : moveToLAN(threadData.rootBestMove);
+        return fen + " | " + std::to_string(threadData.rootScore) + " | " + bestMove;
+    }
+}
+
+perft_t evalBatch(const std::string& inFile, const std::string& outFile, int depth, perft_t nodes, int threads, int hash,
+                  uciopt::Options options) {
+    // Step 1: Apply the settings
+    threads = std::max(threads, 1);
+    options.hash = std::clamp(hash, uciopt::HASH_MIN, uciopt::HASH_MAX);
+    const bool search = depth > 0 or nodes > 0;
+
+    // Step 2: Open the files
+    std::ifstream in(inFile);
+    if (!in) {
+        std::cout << "info string could not open " << inFile << std::endl;
+        return 0;
+    }
+    std::ofstream out(outFile);
+    if (!out) {
+        std::cout << "info string could not open " << outFile << std::endl;
+        return 0;
+    }
+
+    // Step 3: Score the positions
+    // Every thread reads the next line, scores it, and then writes every finished result that is next in line
+    // Results that finish early wait in pending, so the output is in the same order as the input
+    std::mutex ioMutex;
+    perft_t nextInput = 0;
+    perft_t nextOutput = 0;
+    std::map<perft_t, std::string> pending;
+    const auto start = std::chrono::steady_clock::now();
+    const auto getPositionsPerSecond = [&] {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return perft_t(double(nextOutput) / std::max(seconds, 0.001));
+    };
+
+    const auto worker = [&] {
+        // Every thread has its own engine, and reuses its ThreadData for every position
+        sg::SearchContext context(options);
+        context.limits.depthLimit = depth > 0 ? std::min(depth, 100) : 100;
+        context.limits.nodesLimit = nodes > 0 ? nodes : INT64_MAX;
+        context.limits.hardNodesLimit = context.limits.nodesLimit;
+        sg::ThreadData threadData;
+        std::string line;
+        while (true) {
+            // Step 3.1: Get the next position
+            std::string fen;
+            perft_t index;
+            {
+                std::lock_guard<std::mutex> lock(ioMutex);
+                while (fen.empty()) {
+                    if (!getline(in, line))
+                        return;
+                    fen = getFEN(line);
+                }
+                index = nextInput++;
+            }
+
+            // Step 3.2: Score it
+            std::string result = evaluate(context, threadData, fen, search);
+
+            // Step 3.3: Write everything that is ready
+            std::lock_guard<std::mutex> lock(ioMutex);
+            pending.emplace(index, std::move(result));
+            while (!pending.empty() and pending.begin()->first == nextOutput) {
+                out << pending.begin()->second << '\n';
+                pending.erase(pending.begin());
+                if (++nextOutput % 100000 == 0) {
+                    std::cout << "info string evalbatch positions " << nextOutput
+                              << " positions/s " << getPositionsPerSecond() << std::endl;
+                }
+            }
+        } // end while true
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(worker);
+    for (std::thread& thread : workers)
+        thread.join();
+
+    // Step 4: Print the summary
+    std::cout << "info string evalbatch finished " << nextOutput << " positions, "
+              << getPositionsPerSecond() << " positions/s" << std::endl;
+    return nextOutput;
+}
+
+perft_t runEvalBatchCommand(const std::vector<std::string>& args, const uciopt::Options& options) {
+    std::string inFile;
+    std::string outFile;
+    int depth = 0;
+    perft_t nodes = 0;
+    int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    int hash = EVALBATCH_HASH_DEFAULT;
+    try {
+        if (args.size() < 2 or args.size() % 2 != 0)
+            throw std::invalid_argument("wrong number of arguments");
+        inFile = args[0];
+        outFile = args[1];
+        for (size_t i = 2; i < args.size(); i += 2) {
+            if (args[i] == "depth")
+                depth = std::stoi(args[i + 1]);
+            else if (args[i] == "nodes")
+                nodes = std::stoll(args[i + 1]);
+            else if (args[i] == "threads")
+                threads = std::stoi(args[i + 1]);
+            else if (args[i] == "hash")
+                hash = std::stoi(args[i + 1]);
+            else
+                throw std::invalid_argument("unknown argument");
+        }
+    }
+    catch (const std::exception& e) {
+        std::cout << "info string usage: evalbatch <infile> <outfile> [depth <depth> | nodes <nodes>] "
+                     "[threads <threads>] [hash <hash>]" << std::endl;
+        return 0;
+    }
+    return evalBatch(inFile, outFile, depth, nodes, threads, hash, options);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "uciopt.h"
+
+constexpr int EVALBATCH_HASH_DEFAULT = 1;
+
+// Scores every FEN in inFile (one per line, anything after a '[' is ignored) and writes "<fen> | <score> | <bestmove>"
+// lines to outFile, in the same order as the input
+// If depth and nodes are both 0, the score is the static eval and the best move is 0000
+// Otherwise, every position gets its own search with an empty TT and history, so the results don't depend on
+// the number of threads or on the other positions. Scores are from the side to move's point of view
+// Every thread's engine gets options, with the hash size changed to hash
+// Returns the number of positions written
+perft_t evalBatch(const std::string& inFile, const std::string& outFile, int depth, perft_t nodes, int threads, int hash,
+                  uciopt::Options options = {});
+
+// Parses "<infile> <outfile> [depth <depth> | nodes <nodes>] [threads <threads>] [hash <hash>]" and then runs evalBatch
+// This is used by both the evalbatch UCI command and the evalbatch command line argument
+perft_t runEvalBatchCommand(const std::vector<std::string>& args, const uciopt::Options& options = {});
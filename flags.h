@@ -192,6 +192,18 @@ namespace mvs {
         return isCapture(move) or getPiece(move) == pcs::PAWN;
     }
 
+    // Move ordering puts a score in the bits above bit 22 (see moveorder.cpp)
+    // This gets the move without the score
+    inline move_t removeScore(move_t move) {
+        return move & 0x3fffff;
+    }
+
+    // Gets an index from 0 to 767 for the moving piece (including which side it is) and the destination square
+    // This is used to index continuation history and countermoves
+    inline int getPieceTo(move_t move, side_t side) {
+        return (side * 6 + getPiece(move)) * 64 + getTo(move);
+    }
+
 
 
     inline move_t constructMove(move_t from, move_t to, move_t flag, piece_t piece, piece_t capturedPiece) {
@@ -224,5 +224,40 @@ namespace hce {
         // Step 4: Return the eval from the perspective of stm
         return (board.getSTM() == sides::WHITE) ? whiteRelativeEval : -whiteRelativeEval;
     }
-}
 
+    phase_t getTermCounts(const ChessBoard& board, std::vector<std::pair<int16_t, int16_t>>& termCounts) {
+        // This does the same loop as getStaticEval, but it writes down which terms it uses instead of adding them up
+        phase_t phase = 0;
+        const bitboard_t allPieces = board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK);
+        for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+            int16_t mobilityCount = 0;
+            for (side_t side = 0; side < 2; side++) {
+                const square_t kingSquare = log2ll(board.getPieceBB(pcs::KING) & board.getSideBB(side));
+                const auto kingBucket = hce::getFriendlyKingBucket(kingSquare, side);
+                const bitboard_t notFriendlyPieces = ~board.getSideBB(side);
+                const int16_t multiplier = side == sides::WHITE ? 1 : -1;
+                bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
+                phase += hce::PHASE_PIECE_VALUES[piece] * std::popcount(remainingPieces);
+                while (remainingPieces) {
+                    const bitboard_t squareBB = remainingPieces & -remainingPieces;
+                    remainingPieces -= squareBB;
+                    const square_t square = log2ll(squareBB);
+
+                    // real_psts[bucket][piece][square] is psts[bucket][piece][flipSquare(square)]
+                    const int term = (kingBucket * 6 + piece) * 64 + flipSquare(square ^ (7 * side));
+                    termCounts.emplace_back(int16_t(term), multiplier);
+                    const bitboard_t attacks = getAttackedSquares(square, piece, allPieces, side);
+                    mobilityCount += int16_t(std::popcount(attacks & notFriendlyPieces) * multiplier);
+                } // end while remainingPieces
+            } // end for loop over side
+            if (mobilityCount != 0)
+                termCounts.emplace_back(int16_t(NUM_PST_TERMS + piece), mobilityCount);
+        } // end for loop over piece type
+        return std::min(phase, MAX_PHASE);
+    }
+
+    std::pair<int, int> getTerm(int term) {
+        const packed_eval_t packed = term < NUM_PST_TERMS ? psts[term / 384][term / 64 % 6][term % 64] : mobility[term - NUM_PST_TERMS];
+        return {int16_t(uint16_t((packed + (1U << 15)) >> 16)), int16_t(uint16_t(packed))};
+    }
+}
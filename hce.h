@@ -2,6 +2,23 @@
 
 #include "chessboard.h"
 
+#include <utility>
+#include <vector>
+
 namespace hce {
     eval_t getStaticEval(const ChessBoard& board);
+
+    // Everything below is for the Texel tuner (texeltuner.cpp)
+    // The eval is linear, so it is the sum over every term of (count of the term) * S(mg, eg), interpolated by phase
+    // Terms 0 to 767 are the PSTs, in the same order as the psts table in hce.cpp
+    // Terms 768 to 773 are the mobility of each piece type
+    constexpr int NUM_PST_TERMS = 2 * 6 * 64;
+    constexpr int NUM_TERMS = NUM_PST_TERMS + 6;
+
+    // Appends the (term, count) pairs of the position, where white pieces count +1 and black pieces count -1
+    // Returns the phase (0 to 24) that the eval uses
+    phase_t getTermCounts(const ChessBoard& board, std::vector<std::pair<int16_t, int16_t>>& termCounts);
+
+    // Gets the current value of a term as (mg, eg)
+    std::pair<int, int> getTerm(int term);
 }
\ No newline at end of file
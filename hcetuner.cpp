@@ -8,15 +8,28 @@
  * (for example, if you have 10000 fens, mobility is "actually" a tensor of size 10000*6,
  * but this treats it as a 1D array of size 60000.
  * It is a simple matter for python to reshape the array.
+ *
+ * There are two ways to use this:
+ * 1) The old functions (getKingSquares, getMobility, ...) read the first length positions of Noah.epd every time they are called
+ * 2) openBook reads and parses a book once, and returns a handle.
+ *    The bookGet... functions extract features from the handle with a pool of threads,
+ *    and closeBook frees the memory. This is much faster for big books.
+ *    openPackedBook does the same for a file of packed positions (see packedboard.h), which skips parsing text.
  */
 
 #include "chessboard.h"
 #include "logarithm.h"
 #include "attacks.h"
+#include "packedboard.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
 
 const std::string bookFilename = "Noah.epd";
 
@@ -44,14 +57,53 @@ std::vector<ChessBoard> readBook(const int length) {
     return book;
 }
 
-extern "C" void getKingSquares (const int side, int arr[], const int length) {
-    std::vector<ChessBoard> boards = readBook(length);
+// Gets the square of the king of side, flipped so that it is from side's point of view
+// Squares are numbered like python-chess (h1=7) for PST interpretability
+static int getKingSquare(const ChessBoard& board, const int side) {
+    // Step 1: Get the square
+    const bitboard_t kingBB = board.getSideBB(side) & board.getPieceBB(pcs::KING);
+    square_t square = log2ll(kingBB);
 
-    for (int i = 0; i < length; i++) {
-        // Step 1: Get the square
-        const ChessBoard board = boards.at(i);
-        const bitboard_t kingBB = board.getSideBB(side) & board.getPieceBB(pcs::KING);
-        square_t square = log2ll(kingBB);
+    // Step 2: Annoying processing with the square
+    // We have to flip the square vertically if the side is black
+    square ^= side * 7;
+    // We also have to switch from a8=7 to h1=7
+    // This is done for PST interpretability and compatibility with python-chess
+    const square_t file = squares::getFile(square);
+    const square_t rank = squares::getRank(square);
+    return squares::squareFromFileRank(rank, file); // Yes this is supposed to pass in arguments "backwards"
+}
+
+// Adds the mobility of each piece type of side to arr[0] through arr[5]
+static void addMobility(const ChessBoard& board, const int side, int arr[]) {
+    const bitboard_t allPieces = board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK);
+    const bitboard_t notFriendlyPieces = ~board.getSideBB(side);
+    for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+        bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
+        bitboard_t squareBB;
+        square_t square;
+        while (remainingPieces) {
+            squareBB = remainingPieces & -remainingPieces;
+            remainingPieces -= squareBB;
+            square = log2ll(squareBB);
+            const bitboard_t attacks = getAttackedSquares(square, piece, allPieces, side);
+            arr[piece] += std::popcount(attacks & notFriendlyPieces);
+        } // end while remainingPieces
+    } // end for loop over piece
+}
+
+// Writes the squares of every piece of side and type piece to arr[0] through arr[maxPieces - 1]
+// Unused entries are 64
+static void writePSTSquares(const ChessBoard& board, const int side, const int piece, const int maxPieces, int arr[]) {
+    bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
+    bitboard_t squareBB;
+    square_t square;
+    int index = 0;
+    while (remainingPieces) {
+        // Step 1: Find the square
+        squareBB = remainingPieces & -remainingPieces;
+        remainingPieces -= squareBB;
+        square = log2ll(squareBB);
 
         // Step 2: Annoying processing with the square
         // We have to flip the square vertically if the side is black
@@ -62,67 +114,34 @@ extern "C" void getKingSquares (const int side, int arr[], const int length) {
         const square_t rank = squares::getRank(square);
         square = squares::squareFromFileRank(rank, file); // Yes this is supposed to pass in arguments "backwards"
 
-        // Step 3: Put the square in the array
-        arr[i] = square;
+        // Step 3: Write the square to the array
+        arr[index++] = square;
+    } // end while remainingPieces
+
+    while (index < maxPieces) {
+        arr[index++] = 64; // 64 is the code for "this piece is not on the board"
     }
 }
 
+extern "C" void getKingSquares (const int side, int arr[], const int length) {
+    std::vector<ChessBoard> boards = readBook(length);
+    for (int i = 0; i < length; i++)
+        arr[i] = getKingSquare(boards[i], side);
+}
+
 extern "C" void getMobility(const int side, int arr[], const int length) {
     // NOTE: The array is implicitly 2D
     // So it is length*6
     // So arr[] is length 600 if length is 100
     std::vector<ChessBoard> boards = readBook(length);
-    for (int i = 0; i < length; i++) {
-        const ChessBoard board = boards.at(i);
-        const bitboard_t allPieces = board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK);
-        const bitboard_t notFriendlyPieces = ~board.getSideBB(side);
-        for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
-            const int index = i * 6 + piece;
-            bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
-            bitboard_t squareBB;
-            square_t square;
-            while (remainingPieces) {
-                squareBB = remainingPieces & -remainingPieces;
-                remainingPieces -= squareBB;
-                square = log2ll(squareBB);
-                const bitboard_t attacks = getAttackedSquares(square, piece, allPieces, side);
-                arr[index] += std::popcount(attacks & notFriendlyPieces);
-            } // end while remainingPieces
-        } // end for loop over piece
-    } // end for loop over i
+    for (int i = 0; i < length; i++)
+        addMobility(boards[i], side, arr + i * 6);
 } // end getMobility
 
 extern "C" void getPSTs(const int side, const int piece, const int maxPieces, int arr[], const int length) {
     std::vector<ChessBoard> boards = readBook(length);
-    for (int i = 0; i < length; i++) {
-        const ChessBoard board = boards.at(i);
-        bitboard_t remainingPieces = board.getPieceBB(piece) & board.getSideBB(side);
-        bitboard_t squareBB;
-        square_t square;
-        int index = i * maxPieces;
-        while (remainingPieces) {
-            // Step 1: Find the square
-            squareBB = remainingPieces & -remainingPieces;
-            remainingPieces -= squareBB;
-            square = log2ll(squareBB);
-
-            // Step 2: Annoying processing with the square
-            // We have to flip the square vertically if the side is black
-            square ^= side * 7;
-            // We also have to switch from a8=7 to h1=7
-            // This is done for PST interpretability and compatibility with python-chess
-            const square_t file = squares::getFile(square);
-            const square_t rank = squares::getRank(square);
-            square = squares::squareFromFileRank(rank, file); // Yes this is supposed to pass in arguments "backwards"
-
-            // Step 3: Write the square to the array
-            arr[index++] = square;
-        } // end while remainingPieces
-
-        while (index < maxPieces * (i + 1)) {
-            arr[index++] = 64; // 64 is the code for "this piece is not on the board"
-        }
-    } // end for loop over i
+    for (int i = 0; i < length; i++)
+        writePSTSquares(boards[i], side, piece, maxPieces, arr + i * maxPieces);
 }
 
 int get_phase(const std::string& fen) {
@@ -198,6 +217,16 @@ extern "C" void getPhases(int arr[], const int length) {
     file.close();
 }
 
+// Gets the result in square brackets at the end of an EPD line, like [0.5]
+static float getResult(const std::string& line) {
+    std::stringstream ss(line);
+    std::string word;
+    getline(ss, word, '[');
+    float result = -100; // If it stays -100 we know we did something wrong
+    ss >> result;
+    return result;
+}
+
 extern "C" void getResults(float arr[], const int length) {
     // Step 1: Initialize stuff
     std::ifstream file(bookFilename);
@@ -213,13 +242,168 @@ extern "C" void getResults(float arr[], const int length) {
             exit(1);
         }
         getline(file, line);
-        std::stringstream ss(line);
-        getline(ss,line,'[');
-        float result = -100; // If it stays -100 we know we did something wrong
-        ss >> result;
-        arr[i] = result;
+        arr[i] = getResult(line);
     }
 
     // Step 3: Close the file
     file.close();
-}
\ No newline at end of file
+}
+
+// A book that has been read and parsed once, for the handle-based functions below
+// The positions are kept packed (32 bytes each) and unpacked again by every bookGet... function,
+// since a ChessBoard is several times bigger and books can have tens of millions of positions
+struct TunerBook {
+    std::vector<PackedBoard> positions;
+    std::vector<int> phases;
+    int threads = 1;
+};
+
+// Calls body(i) for every position in the book, splitting the positions into one contiguous chunk per thread
+// Every i is handled by exactly one thread, so body can write to index i of an array without locking
+template <typename Body>
+static void parallelFor(const size_t length, const int threads, Body&& body) {
+    const size_t threadCount = std::clamp(size_t(threads), size_t(1), std::max(length, size_t(1)));
+    const size_t chunkSize = (length + threadCount - 1) / threadCount;
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threadCount; t++) {
+        workers.emplace_back([&, t] {
+            for (size_t i = t * chunkSize; i < std::min(length, (t + 1) * chunkSize); i++)
+                body(i);
+        });
+    }
+    for (size_t i = 0; i < std::min(length, chunkSize); i++)
+        body(i);
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+// Fills book.phases from book.positions
+// This is the same as get_phase, but from the bitboards instead of the FEN
+static void setPhases(TunerBook& book) {
+    book.phases.resize(book.positions.size());
+    parallelFor(book.positions.size(), book.threads, [&](const size_t i) {
+        const ChessBoard board = ChessBoard::fromPacked(book.positions[i]);
+        const int phase = std::popcount(board.getPieceBB(pcs::KNIGHT) | board.getPieceBB(pcs::BISHOP)) +
+                2 * std::popcount(board.getPieceBB(pcs::ROOK)) + 4 * std::popcount(board.getPieceBB(pcs::QUEEN));
+        book.phases[i] = std::min(phase, 24);
+    });
+}
+
+// Reads the first maxLength positions of the EPD file at path (or all of them if maxLength is negative),
+// and parses them with the given number of threads (0 means one per core)
+// Lines without a result are skipped
+// Returns a handle for the bookGet... functions, or nullptr if the file can't be opened
+// The handle must be freed with closeBook
+extern "C" void* openBook(const char* path, const int maxLength, const int threads) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cout << "Error in openBook: could not open " << path << std::endl;
+        return nullptr;
+    }
+    auto* book = new TunerBook;
+    book->threads = threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+
+    // The file is read in batches, so only one batch of lines is in memory at a time
+    constexpr size_t BATCH_SIZE = 1 << 16;
+    const size_t limit = maxLength < 0 ? SIZE_MAX : size_t(maxLength);
+    std::vector<std::string> lines;
+    std::vector<uint8_t> parsed;
+    std::string line;
+    size_t skipped = 0;
+    bool endOfFile = false;
+    while (!endOfFile and book->positions.size() < limit) {
+        // Step 1: Read the next batch of lines
+        lines.clear();
+        while (lines.size() < BATCH_SIZE and book->positions.size() + lines.size() < limit) {
+            if (!getline(file, line)) {
+                endOfFile = true;
+                break;
+            }
+            if (!line.empty())
+                lines.push_back(line);
+        }
+
+        // Step 2: Parse them in parallel
+        const size_t first = book->positions.size();
+        book->positions.resize(first + lines.size());
+        parsed.assign(lines.size(), false);
+        parallelFor(lines.size(), book->threads, [&](const size_t i) {
+            parsed[i] = packed::fromEPD(lines[i], book->positions[first + i]);
+        });
+
+        // Step 3: Drop the lines that had no result
+        size_t kept = first;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (parsed[i])
+                book->positions[kept++] = book->positions[first + i];
+        }
+        skipped += first + lines.size() - kept;
+        book->positions.resize(kept);
+    } // end while reading batches
+
+    if (skipped > 0)
+        std::cout << "Warning in openBook: skipped " << skipped << " lines without a result" << std::endl;
+    book->positions.shrink_to_fit();
+    setPhases(*book);
+    return book;
+}
+
+// Like openBook, but for a file of packed positions (see packedboard.h)
+// The file is memory-mapped, so this is much faster than parsing an EPD file
+extern "C" void* openPackedBook(const char* path, const int maxLength, const int threads) {
+    const packed::Reader reader(path);
+    if (!reader.isOpen()) {
+        std::cout << "Error in openPackedBook: could not open " << path << std::endl;
+        return nullptr;
+    }
+    const size_t length = maxLength < 0 ? reader.size() : std::min(reader.size(), size_t(maxLength));
+
+    auto* book = new TunerBook;
+    book->threads = threads > 0 ? threads : int(std::max(1u, std::thread::hardware_concurrency()));
+    book->positions.assign(reader.begin(), reader.begin() + length);
+    setPhases(*book);
+    return book;
+}
+
+// Frees the memory of a book from openBook
+extern "C" void closeBook(void* handle) {
+    delete static_cast<TunerBook*>(handle);
+}
+
+// Gets the number of positions in the book, which is the length of the arrays that python has to allocate
+extern "C" int getBookLength(void* handle) {
+    return int(static_cast<TunerBook*>(handle)->positions.size());
+}
+
+extern "C" void bookGetKingSquares(void* handle, const int side, int arr[]) {
+    const TunerBook& book = *static_cast<TunerBook*>(handle);
+    parallelFor(book.positions.size(), book.threads, [&](const size_t i) {
+        arr[i] = getKingSquare(ChessBoard::fromPacked(book.positions[i]), side);
+    });
+}
+
+extern "C" void bookGetMobility(void* handle, const int side, int arr[]) {
+    // NOTE: Like getMobility, the array is implicitly 2D, so it is length*6
+    const TunerBook& book = *static_cast<TunerBook*>(handle);
+    parallelFor(book.positions.size(), book.threads, [&](const size_t i) {
+        addMobility(ChessBoard::fromPacked(book.positions[i]), side, arr + i * 6);
+    });
+}
+
+extern "C" void bookGetPSTs(void* handle, const int side, const int piece, const int maxPieces, int arr[]) {
+    const TunerBook& book = *static_cast<TunerBook*>(handle);
+    parallelFor(book.positions.size(), book.threads, [&](const size_t i) {
+        writePSTSquares(ChessBoard::fromPacked(book.positions[i]), side, piece, maxPieces, arr + i * maxPieces);
+    });
+}
+
+extern "C" void bookGetPhases(void* handle, int arr[]) {
+    const TunerBook& book = *static_cast<TunerBook*>(handle);
+    std::copy(book.phases.begin(), book.phases.end(), arr);
+}
+
+extern "C" void bookGetResults(void* handle, float arr[]) {
+    const TunerBook& book = *static_cast<TunerBook*>(handle);
+    for (size_t i = 0; i < book.positions.size(); i++)
+        arr[i] = float(book.positions[i].result) / 2;
+}
@@ -1,5 +1,65 @@
 #include "uci.h"
-int main() {
+#include "bench.h"
+#include "datagen.h"
+#include "match.h"
+#include "evalbatch.h"
+#include "packedboard.h"
+#include "book.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    // "./amethyst_chess3 bench <depth> <threads> <hash> [fenfile] [trials]" runs bench and exits
+    if (argc > 1 and std::string(argv[1]) == "bench") {
+        runBenchCommand(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+
+    // "./amethyst_chess3 datagen <outfile> <games> <threads> [nodes] [bookfile] [hash]" generates training data and exits
+    if (argc > 1 and std::string(argv[1]) == "datagen") {
+        runDatagenCommand(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+
+    // "./amethyst_chess3 match <openings> <games> <threads> <engine1> <engine2> [elo0] [elo1]" plays a match and exits
+    if (argc > 1 and std::string(argv[1]) == "match") {
+        runMatchCommand(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+
+    // "./amethyst_chess3 evalbatch <infile> <outfile> [depth <depth> | nodes <nodes>] [threads <threads>] [hash <hash>]"
+    // scores every position in infile and exits
+    if (argc > 1 and std::string(argv[1]) == "evalbatch") {
+        runEvalBatchCommand(std::vector<std::string>(argv + 2, argv + argc));
+        return 0;
+    }
+
+    // "./amethyst_chess3 pack <in.epd> <out.bin>" converts EPD training data to packed positions (see packedboard.h)
+    // and "./amethyst_chess3 unpack <in.bin> <out.epd>" converts it back
+    if (argc == 4 and (std::string(argv[1]) == "pack" or std::string(argv[1]) == "unpack")) {
+        const perft_t count = std::string(argv[1]) == "pack" ? packed::convertEPDToPacked(argv[2], argv[3])
+                                                             : packed::convertPackedToEPD(argv[2], argv[3]);
+        if (count < 0) {
+            std::cout << "could not open " << argv[2] << " or " << argv[3] << std::endl;
+            return 1;
+        }
+        std::cout << "converted " << count << " positions" << std::endl;
+        return 0;
+    }
+
+    // "./amethyst_chess3 makebook <in.txt> <out.bin>" makes an opening book from evalbatch output (see book.h)
+    if (argc == 4 and std::string(argv[1]) == "makebook") {
+        const perft_t count = book::makeBook(argv[2], argv[3]);
+        if (count < 0) {
+            std::cout << "could not open " << argv[2] << " or " << argv[3] << std::endl;
+            return 1;
+        }
+        std::cout << "wrote " << count << " book entries" << std::endl;
+        return 0;
+    }
+
     uciLoop();
     return 0;
 }
@@ -0,0 +1,353 @@
+#include "match.h"
+
+#include <string>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+
+#include "search.h"
+#include "searchglobals.h"
+#include "uci.h"
+#include "uciopt.h"
+#include "repetitiontable.h"
+
+// Without an openings file, every pair of games starts with this many random moves
+constexpr int RANDOM_OPENING_PLIES = 8;
+// A game is adjudicated as a win when the score is at least this, from the same side's point of view, for this many plies
+constexpr int WIN_ADJUDICATION_SCORE = 1000;
+constexpr int WIN_ADJUDICATION_PLIES = 6;
+// After DRAW_ADJUDICATION_MIN_PLY, a game is adjudicated as a draw when the score is within this for this many plies
+constexpr int DRAW_ADJUDICATION_SCORE = 5;
+constexpr int DRAW_ADJUDICATION_PLIES = 10;
+constexpr int DRAW_ADJUDICATION_MIN_PLY = 80;
+// Games that get this long are drawn
+constexpr int MAX_GAME_PLIES = 500;
+// SPRT bounds for alpha = beta = 0.05
+const double SPRT_LOWER_BOUND = std::log(0.05 / 0.95);
+const double SPRT_UPPER_BOUND = std::log(0.95 / 0.05);
+
+namespace {
+    MoveList getLegalMoves(const ChessBoard& board) {
+        MoveList legalMoves;
+        for (move_t move : board.getPseudoLegalMoves()) {
+            if (board.isLegal(move))
+                legalMoves.push_back(move);
+        }
+        return legalMoves;
+    }
+
+    // Gets the opening for a pair of games
+    // Random openings are seeded by the pair, so both games of the pair get the same one
+    ChessBoard getOpening(const std::vector<std::string>& openings, const int pair) {
+        if (!openings.empty())
+            return ChessBoard::fromFEN(openings[pair % openings.size()]);
+
+        std::mt19937_64 rng(pair);
+        while (true) {
+            ChessBoard board = ChessBoard::startpos();
+            for (int ply = 0; ply < RANDOM_OPENING_PLIES; ply++) {
+                const MoveList legalMoves = getLegalMoves(board);
+                if (legalMoves.size == 0)
+                    break;
+                board.makemove(legalMoves.at(rng() % legalMoves.size));
+            }
+            if (getLegalMoves(board).size != 0)
+                return board;
+        }
+    }
+
+    // Plays one game, where engines[side] plays side and *contexts[side] is its engine
+    // Returns 1 if white wins, 0 for a draw, and -1 if black wins
+    int playGame(ChessBoard board, const std::array<const EngineConfig*, 2>& engines, const std::array<sg::SearchContext*, 2>& contexts) {
+        // Step 1: Start with empty TTs and repetition tables, like after ucinewgame
+        // The game is kept track of here, and every engine gets a copy of the repetition tables before it searches
+        for (side_t side = 0; side < 2; side++)
+            contexts[side]->tt.clear();
+        std::array<RepetitionTable, 2> repetitionTables{};
+        repetitionTables[board.getSTM()].insert(board.getZobristCode());
+        std::array<int, 2> clocks = {engines[sides::WHITE]->timeMs, engines[sides::BLACK]->timeMs};
+
+        // Step 2: Play moves until the game is over or adjudicated
+        int winPlies = 0;
+        int drawPlies = 0;
+        eval_t lastWhiteScore = 0;
+        for (int ply = 0; ; ply++) {
+            // Step 2.1: Check if the game is over
+            const side_t stm = board.getSTM();
+            if (getLegalMoves(board).size == 0)
+                return board.isInCheck() ? (stm == sides::WHITE ? -1 : 1) : 0;
+            if (board.getHalfmove() >= 100 or ply >= MAX_GAME_PLIES or
+            std::popcount(board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK)) == 2)
+                return 0;
+
+            // Step 2.2: Set up the engine to move, with the game so far and its limits
+            const EngineConfig& engine = *engines[stm];
+            sg::SearchContext& context = *contexts[stm];
+            context.repetitionTables = repetitionTables;
+            context.limits = sg::SearchLimits();
+            if (engine.nodes > 0) {
+                context.limits.nodesLimit = engine.nodes;
+                context.limits.hardNodesLimit = engine.nodes;
+            }
+            else {
+                context.setClockLimits(clocks[stm], engine.incMs);
+            }
+
+            // Step 2.3: Search
+            const auto start = std::chrono::steady_clock::now();
+            const sg::ThreadData searchResult = rootSearch(context, board, false);
+            const auto msElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+            // Step 2.4: Update the clock
+            if (engine.nodes == 0) {
+                clocks[stm] -= int(msElapsed);
+                if (clocks[stm] < 0)
+                    return stm == sides::WHITE ? -1 : 1; // lost on time
+                clocks[stm] += engine.incMs;
+            }
+
+            // Step 2.5: Adjudicate
+            const eval_t whiteScore = stm == sides::WHITE ? searchResult.rootScore : eval_t(-searchResult.rootScore);
+            const bool sameWinner = (whiteScore > 0) == (lastWhiteScore > 0);
+            winPlies = std::abs(whiteScore) >= WIN_ADJUDICATION_SCORE and sameWinner ? winPlies + 1 : 0;
+            drawPlies = ply >= DRAW_ADJUDICATION_MIN_PLY and std::abs(whiteScore) <= DRAW_ADJUDICATION_SCORE ? drawPlies + 1 : 0;
+            lastWhiteScore = whiteScore;
+            if (winPlies >= WIN_ADJUDICATION_PLIES)
+                return whiteScore > 0 ? 1 : -1;
+            if (drawPlies >= DRAW_ADJUDICATION_PLIES)
+                return 0;
+
+            // Step 2.6: Make the move, keeping track of repetitions the same way the position command does
+            const move_t bestMove = searchResult.rootBestMove;
+            if (mvs::isIrreversible(bestMove)) {
+                repetitionTables[sides::WHITE].clear();
+                repetitionTables[sides::BLACK].clear();
+            }
+            board.makemove(bestMove);
+            if (repetitionTables[board.getSTM()].isRepeated(board.getZobristCode()))
+                return 0;
+            repetitionTables[board.getSTM()].insert(board.getZobristCode());
+        } // end for loop over plies
+    }
+
+    // Converts an expected score into logistic Elo
+    double scoreToElo(double score) {
+        score = std::clamp(score, 1e-6, 1 - 1e-6);
+        return -400 * std::log10(1 / score - 1);
+    }
+
+    double eloToScore(double elo) {
+        return 1 / (1 + std::pow(10, -elo / 400));
+    }
+
+    // The pentanomial counts: how many pairs scored 0, 0.5, 1, 1.5 and 2 points for the first engine
+    using Pentanomial = std::array<int, 5>;
+
+    // Gets the mean and variance of the score per pair (from 0 to 1), with the pairs as independent samples
+    std::pair<double, double> getPairStats(const Pentanomial& pentanomial) {
+        const int pairs = std::accumulate(pentanomial.begin(), pentanomial.end(), 0);
+        double mean = 0;
+        for (int i = 0; i < 5; i++)
+            mean += pentanomial[i] * (i / 4.0);
+        mean /= pairs;
+        double variance = 0;
+        for (int i = 0; i < 5; i++)
+            variance += pentanomial[i] * (i / 4.0 - mean) * (i / 4.0 - mean);
+        return {mean, variance / pairs};
+    }
+
+    // The log-likelihood ratio of elo1 against elo0, with the normal approximation that fishtest uses
+    double getLLR(const Pentanomial& pentanomial, double elo0, double elo1) {
+        const int pairs = std::accumulate(pentanomial.begin(), pentanomial.end(), 0);
+        const auto [mean, variance] = getPairStats(pentanomial);
+        if (pairs == 0 or variance <= 0)
+            return 0;
+        const double score0 = eloToScore(elo0);
+        const double score1 = eloToScore(elo1);
+        return pairs * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+    }
+}
+
+bool parseEngineConfig(const std::string& spec, EngineConfig& config) {
+    std::stringstream ss(spec);
+    std::string item;
+    while (getline(ss, item, ',')) {
+        const size_t equals = item.find('=');
+        if (equals == std::string::npos) {
+            std::cout << "info string expected key=value in engine " << spec << " but got " << item << std::endl;
+            return false;
+        }
+        const std::string key = item.substr(0, equals);
+        const std::string value = item.substr(equals + 1);
+        try {
+            if (key == "name")
+                config.name = value;
+            else if (key == "nodes")
+                config.nodes = std::stoll(value);
+            else if (key == "tc") {
+                // tc=<ms>+<increment ms>
+                config.timeMs = std::stoi(value);
+                config.incMs = value.find('+') == std::string::npos ? 0 : std::stoi(value.substr(value.find('+') + 1));
+                config.nodes = 0;
+            }
+            else if (key == "SyzygyPath") {
+                std::cout << "info string SyzygyPath is shared by both engines, set it before the match instead" << std::endl;
+                return false;
+            }
+            else
+                config.options.emplace_back(key, value);
+        }
+        catch (const std::exception& e) {
+            std::cout << "info string could not parse " << item << " in engine " << spec << std::endl;
+            return false;
+        }
+    } // end while loop over items
+    if (config.name.empty())
+        config.name = spec;
+    return true;
+}
+
+MatchResult match(const std::string& openingsFile, int games, int threads, const EngineConfig& engine1,
+                  const EngineConfig& engine2, const double elo0, const double elo1, const uciopt::Options& baseOptions) {
+    // Step 1: Read the openings
+    std::vector<std::string> openings;
+    if (!openingsFile.empty()) {
+        std::ifstream file(openingsFile);
+        std::string line;
+        while (getline(file, line)) {
+            if (!line.empty())
+                openings.push_back(line.substr(0, line.find('[')));
+        }
+        if (openings.empty()) {
+            std::cout << "info string no positions found in " << openingsFile << std::endl;
+            return {};
+        }
+    }
+    const int pairs = std::max(games / 2, 1);
+    threads = std::max(threads, 1);
+
+    // Step 2: Make a pair of engines for every thread, which get their options once and then keep them
+    // contexts[2 * t] is engine1 and contexts[2 * t + 1] is engine2 on thread t
+    // An option that neither engine knows would silently turn the match into a self-match, so it stops the match
+    // Keys can use _ for spaces, but SPSA tunables have real underscores in their names, so those are tried first
+    std::deque<sg::SearchContext> contexts;
+    for (int t = 0; t < threads; t++) {
+        for (const EngineConfig* engine : {&engine1, &engine2}) {
+            sg::SearchContext& context = contexts.emplace_back(baseOptions);
+            for (const auto& [name, value] : engine->options) {
+                std::string spacedName = name;
+                std::replace(spacedName.begin(), spacedName.end(), '_', ' ');
+                if (!setOption(context, name, value, false) and !setOption(context, spacedName, value, false)) {
+                    std::cout << "info string engine " << engine->name << " has no option " << name
+                              << " (SPSA tunables only exist in builds with -DSPSA_TUNING=ON)" << std::endl;
+                    return {};
+                }
+            }
+        }
+    }
+
+    // Step 3: Play the pairs
+    // Every thread takes the next pair that nobody has started yet, until there are none left or the SPRT is done
+    std::atomic<int> nextPair = 0;
+    std::atomic<bool> stop = false;
+    std::mutex resultMutex;
+    MatchResult result;
+    Pentanomial pentanomial{};
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto worker = [&](const int threadIndex) {
+        sg::SearchContext& context1 = contexts[2 * threadIndex];
+        sg::SearchContext& context2 = contexts[2 * threadIndex + 1];
+        for (int pair = nextPair++; pair < pairs and !stop; pair = nextPair++) {
+            const ChessBoard opening = getOpening(openings, pair);
+
+            // Step 3.1: Play the opening with engine1 as white, then as black
+            const int firstGame = playGame(opening, {&engine1, &engine2}, {&context1, &context2});
+            const int secondGame = -playGame(opening, {&engine2, &engine1}, {&context2, &context1});
+
+            // Step 3.2: Add the results, and check the SPRT
+            // Pairs that finish after the SPRT is done are thrown away, so they can't change the verdict
+            std::lock_guard<std::mutex> lock(resultMutex);
+            if (stop)
+                break;
+            for (const int game : {firstGame, secondGame}) {
+                result.wins += game == 1;
+                result.draws += game == 0;
+                result.losses += game == -1;
+            }
+            pentanomial[firstGame + secondGame + 2]++;
+            const auto [mean, variance] = getPairStats(pentanomial);
+            const int pairsPlayed = std::accumulate(pentanomial.begin(), pentanomial.end(), 0);
+            const double eloError = scoreToElo(std::min(1.0, mean + 1.96 * std::sqrt(variance / pairsPlayed))) - scoreToElo(mean);
+            result.elo = scoreToElo(mean);
+            result.llr = getLLR(pentanomial, elo0, elo1);
+            std::cout << std::fixed << std::setprecision(2)
+                      << "info string match " << engine1.name << " vs " << engine2.name
+                      << " games " << 2 * pairsPlayed << " W-D-L " << result.wins << "-" << result.draws << "-" << result.losses
+                      << " penta [" << pentanomial[0] << "," << pentanomial[1] << "," << pentanomial[2] << "," << pentanomial[3] << "," << pentanomial[4] << "]"
+                      << " elo " << result.elo << " +- " << eloError
+                      << " llr " << result.llr << " (" << SPRT_LOWER_BOUND << ", " << SPRT_UPPER_BOUND << ")"
+                      << " games/s " << 2 * pairsPlayed / std::max(0.001, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count())
+                      << std::defaultfloat << std::endl;
+            if (result.llr <= SPRT_LOWER_BOUND or result.llr >= SPRT_UPPER_BOUND)
+                stop = true;
+        } // end for loop over pairs
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++)
+        workers.emplace_back(worker, i);
+    for (std::thread& thread : workers)
+        thread.join();
+
+    // Step 4: Print the verdict
+    if (result.llr >= SPRT_UPPER_BOUND)
+        std::cout << "info string SPRT accepted H1: " << engine1.name << " is at least " << elo1 << " Elo stronger" << std::endl;
+    else if (result.llr <= SPRT_LOWER_BOUND)
+        std::cout << "info string SPRT accepted H0: " << engine1.name << " is not " << elo1 << " Elo stronger" << std::endl;
+    else
+        std::cout << "info string SPRT is inconclusive after " << result.wins + result.draws + result.losses << " games" << std::endl;
+    return result;
+}
+
+MatchResult runMatchCommand(const std::vector<std::string>& args, const uciopt::Options& baseOptions) {
+    std::string openingsFile;
+    int games = 0;
+    int threads = 1;
+    EngineConfig engine1;
+    EngineConfig engine2;
+    double elo0 = 0;
+    double elo1 = 5;
+    try {
+        if (args.size() < 5)
+            throw std::invalid_argument("not enough arguments");
+        if (args[0] != "-")
+            openingsFile = args[0];
+        games = std::stoi(args[1]);
+        threads = std::stoi(args[2]);
+        if (!parseEngineConfig(args[3], engine1) or !parseEngineConfig(args[4], engine2))
+            return {};
+        if (args.size() > 5)
+            elo0 = std::stod(args[5]);
+        if (args.size() > 6)
+            elo1 = std::stod(args[6]);
+    }
+    catch (const std::exception& e) {
+        std::cout << "info string usage: match <openings or -> <games> <threads> <engine1> <engine2> [elo0] [elo1]" << std::endl;
+        std::cout << "info string an engine is like name=dev,nodes=5000,Hash=8 or name=base,tc=8000+80" << std::endl;
+        std::cout << "info string SPSA parameters like RFP_MARGIN=150 only exist in builds with -DSPSA_TUNING=ON" << std::endl;
+        return {};
+    }
+    return match(openingsFile, games, threads, engine1, engine2, elo0, elo1, baseOptions);
+}
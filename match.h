@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "typedefs.h"
+#include "uciopt.h"
+
+// One side of a match: a set of UCI options, plus how long it gets to think
+struct EngineConfig {
+    std::string name;
+    perft_t nodes = 0; // if this is not 0, every move is searched with this many nodes instead of using the clock
+    int timeMs = 10000;
+    int incMs = 100;
+    std::vector<std::pair<std::string, std::string>> options; // passed to setOption before the first game
+};
+
+struct MatchResult {
+    int wins = 0; // from the point of view of the first engine
+    int draws = 0;
+    int losses = 0;
+    double elo = 0;
+    double llr = 0;
+};
+
+// Parses an engine like "name=dev,nodes=5000,Hash=8" or "name=base,tc=8000+80"
+// Every key other than name, nodes and tc is a UCI option (use _ for spaces in option names)
+// SPSA parameters are UCI options too, but only in builds with -DSPSA_TUNING=ON
+// Returns false and prints why if the engine can't be parsed
+bool parseEngineConfig(const std::string& spec, EngineConfig& config);
+
+// Plays pairs of games between the two engines (each opening once with each color) on several threads,
+// and prints the score, Elo and the log-likelihood ratio of the SPRT for elo0 against elo1 after every pair
+// The match stops early when the SPRT accepts either hypothesis (with alpha = beta = 0.05)
+// If openingsFile is empty, every pair starts from a few random moves instead
+// Both engines start with baseOptions, and then get their own options on top
+// If an engine has an option that isn't a UCI option of this build, nothing is played and the result is empty
+MatchResult match(const std::string& openingsFile, int games, int threads, const EngineConfig& engine1,
+                  const EngineConfig& engine2, double elo0, double elo1, const uciopt::Options& baseOptions = {});
+
+// Parses "<openings or -> <games> <threads> <engine1> <engine2> [elo0] [elo1]" and then runs match
+// This is used by both the match UCI command and the match command line argument
+MatchResult runMatchCommand(const std::vector<std::string>& args, const uciopt::Options& baseOptions = {});
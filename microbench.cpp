@@ -0,0 +1,208 @@
+// Microbenchmarks for the primitives that the search spends most of its time in
+// Usage: ./amethyst_microbench [filter]
+// Only benchmarks whose name contains the filter are run
+// Every benchmark reports nanoseconds and heap allocations per operation, for each fixture position
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+#include "chessboard.h"
+#include "attacks.h"
+#include "hce.h"
+#include "tt.h"
+#include "movegenerator.h"
+#include "searchglobals.h"
+#include "uciopt.h"
+
+// Every allocation in this executable goes through these, so we can count allocations per operation
+static uint64_t allocationCount = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    if (void* pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc();
+}
+
+// This is never inlined, since GCC warns about free when it can see that the pointer came from operator new
+[[gnu::noinline]] void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void* pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+// The results of every benchmark get added to this, so that the compiler can't optimize the work away
+static volatile uint64_t sink = 0;
+
+struct Fixture {
+    std::string name;
+    std::string fen;
+};
+
+const std::vector<Fixture> FIXTURES = {
+        {"opening", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"},
+        {"middlegame", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+        {"endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+        {"check", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"},
+};
+
+// Runs body (which does opsPerCall operations) until at least minTime has passed, then prints the results
+template <typename Body>
+void runBenchmark(const std::string& name, const std::string& fixture, const int opsPerCall, Body&& body) {
+    constexpr auto minTime = std::chrono::milliseconds(200);
+
+    // Step 1: Warm up the caches
+    for (int i = 0; i < 100; i++)
+        body();
+
+    // Step 2: Keep doubling the number of calls until the benchmark takes long enough
+    uint64_t calls = 128;
+    while (true) {
+        const uint64_t allocationsBefore = allocationCount;
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < calls; i++)
+            body();
+        const auto end = std::chrono::steady_clock::now();
+        const uint64_t allocations = allocationCount - allocationsBefore;
+
+        if (end - start >= minTime) {
+            const double ops = double(calls) * opsPerCall;
+            const double ns = double(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            std::cout << std::left << std::setw(40) << "BM_" + name + "/" + fixture
+                      << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << ns / ops << " ns/op"
+                      << std::setw(10) << double(allocations) / ops << " allocs/op"
+                      << std::setw(14) << uint64_t(ops) << " ops" << std::endl;
+            return;
+        }
+        calls *= 2;
+    }
+}
+
+// Gets all the legal moves in the position
+MoveList getLegalMoves(const ChessBoard& board) {
+    MoveList legalMoves;
+    for (move_t move : board.getPseudoLegalMoves()) {
+        if (board.isLegal(move))
+            legalMoves.push_back(move);
+    }
+    return legalMoves;
+}
+
+int main(int argc, char* argv[]) {
+    const std::string filter = argc > 1 ? argv[1] : "";
+    const auto shouldRun = [&](const std::string& name) {
+        return name.find(filter) != std::string::npos;
+    };
+
+    // These are shared by all benchmarks, so that their allocations don't count
+    sg::ThreadData threadData;
+    TT tt(uciopt::HASH_DEFAULT);
+    std::mt19937_64 rng(12345);
+    std::vector<zobrist_t> keys(4096);
+    for (zobrist_t& key : keys)
+        key = rng();
+
+    for (const Fixture& fixture : FIXTURES) {
+        const ChessBoard board = ChessBoard::fromFEN(fixture.fen);
+        MoveList pseudolegalMoves = board.getPseudoLegalMoves();
+        const MoveList legalMoves = getLegalMoves(board);
+        MoveList tacticalMoves;
+        board.getMoves(tacticalMoves, TACTICAL_MOVES);
+        // Positions without captures still need something to run SEE on
+        const MoveList& seeMoves = tacticalMoves.size > 0 ? tacticalMoves : legalMoves;
+
+        if (shouldRun("makemove")) {
+            runBenchmark("makemove", fixture.name, int(legalMoves.size), [&] {
+                for (unsigned int i = 0; i < legalMoves.size; i++) {
+                    ChessBoard newBoard = board;
+                    newBoard.makemove(legalMoves.at(i));
+                    sink = sink + newBoard.getZobristCode();
+                }
+            });
+        }
+
+        if (shouldRun("getMoves")) {
+            runBenchmark("getMoves", fixture.name, 1, [&] {
+                MoveList moves;
+                board.getMoves(moves, TACTICAL_MOVES);
+                board.getMoves(moves, QUIET_MOVES);
+                sink = sink + moves.size;
+            });
+        }
+
+        if (shouldRun("isLegal")) {
+            runBenchmark("isLegal", fixture.name, int(pseudolegalMoves.size), [&] {
+                for (unsigned int i = 0; i < pseudolegalMoves.size; i++)
+                    sink = sink + board.isLegal(pseudolegalMoves.at(i));
+            });
+        }
+
+        if (shouldRun("isGoodSEE")) {
+            runBenchmark("isGoodSEE", fixture.name, int(seeMoves.size), [&] {
+                for (unsigned int i = 0; i < seeMoves.size; i++)
+                    sink = sink + board.isGoodSEE(seeMoves.at(i));
+            });
+        }
+
+        if (shouldRun("getAttackedSquares")) {
+            const bitboard_t allPieces = board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK);
+            runBenchmark("getAttackedSquares", fixture.name, 64 * 6, [&] {
+                for (square_t square = 0; square < 64; square++) {
+                    for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++)
+                        sink = sink + getAttackedSquares(square, piece, allPieces, board.getSTM());
+                }
+            });
+        }
+
+        if (shouldRun("getStaticEval")) {
+            runBenchmark("getStaticEval", fixture.name, 1, [&] {
+                sink = sink + hce::getStaticEval(board);
+            });
+        }
+
+        size_t keyIndex = 0;
+        if (shouldRun("TT_put")) {
+            runBenchmark("TT_put", fixture.name, 1, [&] {
+                tt.put(keys[keyIndex++ & 4095], legalMoves.at(0), 0, ttflags::EXACT, 1);
+            });
+        }
+
+        if (shouldRun("TT_get")) {
+            runBenchmark("TT_get", fixture.name, 1, [&] {
+                sink = sink + tt.get(keys[keyIndex++ & 4095]).score;
+            });
+        }
+
+        if (shouldRun("nextMove")) {
+            // One operation is generating every move in the position
+            runBenchmark("nextMove", fixture.name, 1, [&] {
+                MoveGenerator generator(threadData, board, 0, 0);
+                while (move_t move = generator.nextMove())
+                    sink = sink + move;
+            });
+        }
+    } // end for loop over fixtures
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "movegenerator.h"
 
+#include <algorithm>
+
 move_t MoveGenerator::nextPseudolegalMove()  {
     if (stage == TT_MOVE) {
         stage = GOOD_TACTICALS;
@@ -26,7 +28,8 @@ move_t MoveGenerator::nextPseudolegalMove()  {
                     quietsBadTacticals.push_back(move);
                 }
                 else {
-                    goodTacticals.moveList[i] |= getMVVLVAScore(move) << 22;
+                    const int captureHistoryScore = threadData.captureHistory[mvs::getPieceTo(move, board.getSTM())][mvs::getCapturedPiece(move)];
+                    goodTacticals.moveList[i] |= getTacticalScore(move, captureHistoryScore) << 22;
                 } // end else
             } // end for loop over goodTacticals.size
             badTacticalsCount = quietsBadTacticals.size;
@@ -52,8 +55,7 @@ move_t MoveGenerator::nextPseudolegalMove()  {
                     quietsBadTacticals.moveList[i] = quietsBadTacticals.pop_back();
                 }
                 else {
-                    const auto historyScore = threadData.butterflyHistory[board.getSTM()][mvs::getFromTo(move)];
-                    quietsBadTacticals.moveList[i] |= move_t(512 + historyScore) << 22;
+                    quietsBadTacticals.moveList[i] |= getQuietScore(move) << 22;
                 } // end else
             } // end for loop over i
             hasGenerated = true;
@@ -89,8 +91,24 @@ move_t MoveGenerator::nextPseudolegalMove()  {
     exit(1); // We shouldn't ever reach here
 } // end nextPseudolegalMove method
 
-MoveGenerator::MoveGenerator(const sg::ThreadData &threadData, const ChessBoard &board1, move_t ttMove) : threadData(threadData), board(board1) {
+// Quiets are scored from 0 to 1023
+// The killer gets 1023, the countermove gets 1022,
+// and other quiets are scored by butterfly history and 1-ply and 2-ply continuation history
+uint32_t MoveGenerator::getQuietScore(const move_t move) const {
+    const side_t stm = board.getSTM();
+    const move_t lastMove = threadData.searchStack[ply].move;
+
+    if (move == threadData.searchStack[ply].killer)
+        return 1023;
+    if (lastMove != 0 and move == threadData.counterMoves[mvs::getPieceTo(lastMove, stm ^ 1)])
+        return 1022;
+
+    return std::clamp(512 + threadData.getQuietHistory(move, stm, ply) / 3, 0, 1021);
+}
+
+MoveGenerator::MoveGenerator(const sg::ThreadData &threadData, const ChessBoard &board1, move_t ttMove, depth_t ply) : threadData(threadData), board(board1) {
     this->ttMove = ttMove;
+    this->ply = ply;
     stage = TT_MOVE;
     nextMoveIndex = 0;
     badTacticalsCount = 0;
@@ -103,5 +121,5 @@ move_t MoveGenerator::nextMove() {
         move = nextPseudolegalMove();
     }
     while (move != 0 and !board.isLegal(move));
-    return move;
+    return mvs::removeScore(move);
 }
\ No newline at end of file
@@ -19,9 +19,11 @@ private:
     size_t badTacticalsCount;
     bool hasGenerated;
     move_t ttMove;
+    depth_t ply;
 
     move_t nextPseudolegalMove();
+    [[nodiscard]] uint32_t getQuietScore(move_t move) const;
 public:
-    explicit MoveGenerator(const sg::ThreadData &threadData, const ChessBoard &board1, move_t ttMove);
+    explicit MoveGenerator(const sg::ThreadData &threadData, const ChessBoard &board1, move_t ttMove, depth_t ply);
     move_t nextMove();
 }; // end class
@@ -20,6 +20,22 @@ uint32_t getMVVLVAScore(move_t move) {
     return 10 * mvs::getCapturedPiece(move) + 10 - mvs::getPiece(move);
 }
 
+uint32_t getTacticalScore(move_t move, int captureHistoryScore) {
+    // Step 1: Get the victim
+    // Queen promotions count as capturing an extra queen, and underpromotions count as capturing nothing
+    uint32_t victimScore = mvs::isCapture(move) ? mvs::getCapturedPiece(move) + 1 : 0;
+    if (mvs::isPromotion(move)) {
+        if (mvs::getPromotedPiece(move) != pcs::QUEEN)
+            return 0;
+        victimScore += pcs::QUEEN + 1;
+    }
+
+    // Step 2: Capture history goes from -512 to 512, and we squish it to between 0 and 63
+    const uint32_t historyScore = std::clamp(captureHistoryScore + 512, 0, 1023) / 16;
+
+    return victimScore * 64 + historyScore;
+}
+
 // We assume all the moves in here are captures
 void scoreMovesByMVVLVA(MoveList& moves) {
     for (move_t& move : moves)
@@ -3,4 +3,8 @@
 
 uint32_t getMVVLVAScore(move_t move);
 
+// Scores a tactical move by the most valuable victim first, and then by capture history
+// The score is always less than 1024, so it fits in the high bits of a move_t
+uint32_t getTacticalScore(move_t move, int captureHistoryScore);
+
 void scoreMovesByMVVLVA(MoveList& moves);
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "packedboard.h"
+#include "chessboard.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool packed::fromEPD(const std::string& line, PackedBoard& packedBoard) {
+    // Step 1: Split the line into the FEN, the result and the score
+    const size_t resultStart = line.find('[');
+    const size_t resultEnd = line.find(']', resultStart);
+    if (resultStart == std::string::npos or resultEnd == std::string::npos)
+        return false;
+    float result = -1;
+    std::stringstream(line.substr(resultStart + 1, resultEnd - resultStart - 1)) >> result;
+    int score = 0;
+    std::stringstream(line.substr(resultEnd + 1)) >> score;
+
+    // Step 2: Pack it
+    packedBoard = ChessBoard::fromFEN(line.substr(0, resultStart)).toPacked();
+    if (result == 1)
+        packedBoard.result = results::WHITE_WIN;
+    else if (result == 0)
+        packedBoard.result = results::BLACK_WIN;
+    else if (result == 0.5)
+        packedBoard.result = results::DRAW;
+    else
+        return false;
+    packedBoard.score = eval_t(score);
+    return true;
+}
+
+std::string packed::toEPD(const PackedBoard& packedBoard) {
+    constexpr std::array<const char*, 3> RESULT_STRINGS = {"0", "0.5", "1"};
+    return ChessBoard::fromPacked(packedBoard).toFEN() + " [" + RESULT_STRINGS[packedBoard.result] + "] " + std::to_string(packedBoard.score);
+}
+
+perft_t packed::convertEPDToPacked(const std::string& epdFilename, const std::string& packedFilename) {
+    std::ifstream epdFile(epdFilename);
+    std::ofstream packedFile(packedFilename, std::ios::binary);
+    if (!epdFile or !packedFile)
+        return -1;
+
+    perft_t count = 0;
+    std::string line;
+    PackedBoard packedBoard{};
+    while (getline(epdFile, line)) {
+        if (line.empty())
+            continue;
+        if (!fromEPD(line, packedBoard)) {
+            std::cout << "info string skipping line without a result: " << line << std::endl;
+            continue;
+        }
+        packedFile.write(reinterpret_cast<const char*>(&packedBoard), sizeof(PackedBoard));
+        count++;
+    }
+    return count;
+}
+
+perft_t packed::convertPackedToEPD(const std::string& packedFilename, const std::string& epdFilename) {
+    const Reader reader(packedFilename);
+    std::ofstream epdFile(epdFilename);
+    if (!reader.isOpen() or !epdFile)
+        return -1;
+
+    for (const PackedBoard& packedBoard : reader)
+        epdFile << toEPD(packedBoard) << "\n";
+    return perft_t(reader.size());
+}
+
+#ifndef _WIN32
+
+packed::Reader::Reader(const std::string& filename) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat fileStats{};
+    if (fstat(fd, &fileStats) == 0) {
+        // mmap can't map 0 bytes, but an empty file is still a valid file with no positions
+        opened = fileStats.st_size < off_t(sizeof(PackedBoard));
+        if (!opened) {
+            void* mapping = mmap(nullptr, fileStats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                positions = static_cast<const PackedBoard*>(mapping);
+                mappedBytes = fileStats.st_size;
+                length = mappedBytes / sizeof(PackedBoard);
+                opened = true;
+            }
+        }
+    }
+    close(fd);
+}
+
+packed::Reader::~Reader() {
+    if (mappedBytes != 0)
+        munmap(const_cast<PackedBoard*>(positions), mappedBytes);
+}
+
+#else
+
+packed::Reader::Reader(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file)
+        return;
+    fallback.resize(size_t(file.tellg()) / sizeof(PackedBoard));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(fallback.data()), std::streamsize(fallback.size() * sizeof(PackedBoard)));
+    positions = fallback.data();
+    length = fallback.size();
+    opened = true;
+}
+
+packed::Reader::~Reader() = default;
+
+#endif
+
+bool packed::Reader::isOpen() const {
+    return opened;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+
+// A position in 32 bytes, for training and tuning data
+// Files of these are much faster to read than EPD files, because there is no text to parse
+// The pieces are stored in the order of the set bits of occupancy (a1, a2, ..., h8), two per byte
+// Each piece is side << 3 | piece, and the first piece is in the low nibble of pieces[0]
+struct PackedBoard {
+    bitboard_t occupancy;
+    std::array<uint8_t, 16> pieces;
+    uint8_t epCastlingRights; // see the rights namespace in flags.h
+    side_t stm;
+    uint8_t halfmove;         // capped at 255
+    uint8_t result;           // from white's point of view, see packed::results
+    eval_t score;             // from white's point of view
+    uint16_t fullmove;
+};
+static_assert(sizeof(PackedBoard) == 32, "PackedBoard should be 32 bytes");
+
+namespace packed {
+    namespace results {
+        constexpr uint8_t BLACK_WIN = 0;
+        constexpr uint8_t DRAW = 1;
+        constexpr uint8_t WHITE_WIN = 2;
+    }
+
+    // Parses a line like "<fen> [<result>] <score>", where the result is 0, 0.5 or 1 and the score is optional
+    // Returns false if the line has no result
+    bool fromEPD(const std::string& line, PackedBoard& packedBoard);
+
+    // Writes the position in the same format that fromEPD reads
+    std::string toEPD(const PackedBoard& packedBoard);
+
+    // Converts a whole file, and returns the number of positions written, or -1 if a file can't be opened
+    perft_t convertEPDToPacked(const std::string& epdFilename, const std::string& packedFilename);
+    perft_t convertPackedToEPD(const std::string& packedFilename, const std::string& epdFilename);
+
+    // Reads a file of PackedBoards by memory-mapping it, so that opening a huge file is instant
+    // and the positions are only paged in when they are used
+    class Reader {
+    private:
+        const PackedBoard* positions = nullptr;
+        size_t length = 0;
+        size_t mappedBytes = 0;
+        bool opened = false;
+        std::vector<PackedBoard> fallback; // used where mmap is not available
+
+    public:
+        explicit Reader(const std::string& filename);
+        ~Reader();
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        // Returns false if the file could not be opened
+        [[nodiscard]] bool isOpen() const;
+
+        [[nodiscard]] inline size_t size() const {
+            return length;
+        }
+
+        [[nodiscard]] inline const PackedBoard& operator[](size_t index) const {
+            return positions[index];
+        }
+
+        [[nodiscard]] inline const PackedBoard* begin() const {
+            return positions;
+        }
+
+        [[nodiscard]] inline const PackedBoard* end() const {
+            return positions + length;
+        }
+    };
+}
@@ -2,13 +2,18 @@
 #include "movegenerator.h"
 #include <iostream>
 #include <unordered_set>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
 
-std::unordered_set<move_t> allPseudolegalMoves; // This is the set of all pseudolegal moves in all positions everywhere
+static std::unordered_set<move_t> allPseudolegalMoves; // This is the set of all pseudolegal moves in all positions everywhere
 constexpr bool doPseudolegalCheck = false;
 constexpr bool doLANTest = false;
-sg::ThreadData threadData;
 
-perft_t perft(const ChessBoard& board, depth_t depth) {
+// The MoveGenerator needs a ThreadData for move ordering, so perft makes one and passes it down
+// It is never written to, since perft doesn't update any history
+static perft_t perftRecursive(const ChessBoard& board, depth_t depth, const sg::ThreadData& threadData) {
     board.areBitboardsCorrect();
 
     if (depth <= 0)
@@ -40,7 +45,7 @@ perft_t perft(const ChessBoard& board, depth_t depth) {
 //    std::cout << "all pseudolegal moves is size" << allPseudolegalMoves.size();
 
     perft_t count = 0;
-    MoveGenerator generator(threadData, board, 0);
+    MoveGenerator generator(threadData, board, 0, 0);
     while (move_t move = generator.nextMove()) {
         if (!board.isPseudolegal(move)) {
             std::cout << "FAILED isPseudolegal test: move " << moveToLAN(move) << "was in move list but failed isPseudolegal test" << std::endl;
@@ -71,10 +76,122 @@ perft_t perft(const ChessBoard& board, depth_t depth) {
             } // end if constexpr doLANTest
             ChessBoard newBoard = board;
             newBoard.makemove(move);
-            count += perft(newBoard, depth_t(depth - 1));
+            count += perftRecursive(newBoard, depth_t(depth - 1), threadData);
         }
     }
 
     return count;
 }
 
+perft_t perft(const ChessBoard& board, depth_t depth) {
+    const sg::ThreadData threadData;
+    return perftRecursive(board, depth, threadData);
+}
+
+
+// Each entry stores key ^ data and data, so that an entry torn by two threads writing it at once is never matched
+// The depth is stored in the low 8 bits of data and the node count in the rest
+struct PerftHashEntry {
+    std::atomic<uint64_t> keyXorData{0};
+    std::atomic<uint64_t> data{0};
+};
+
+class PerftHash {
+private:
+    std::vector<PerftHashEntry> table;
+
+public:
+    explicit PerftHash(int hashMB) : table(std::max(size_t(1), size_t(hashMB) * 1024 * 1024 / sizeof(PerftHashEntry))) {}
+
+    [[nodiscard]] bool get(zobrist_t zobristCode, depth_t depth, perft_t& count) const {
+        const PerftHashEntry& entry = table[zobristCode % table.size()];
+        const uint64_t data = entry.data.load(std::memory_order_relaxed);
+        const uint64_t keyXorData = entry.keyXorData.load(std::memory_order_relaxed);
+        if ((keyXorData ^ data) != zobristCode or (data & 0xff) != uint64_t(depth))
+            return false;
+        count = perft_t(data >> 8);
+        return true;
+    }
+
+    void put(zobrist_t zobristCode, depth_t depth, perft_t count) {
+        PerftHashEntry& entry = table[zobristCode % table.size()];
+        const uint64_t data = uint64_t(count) << 8 | uint64_t(depth);
+        entry.data.store(data, std::memory_order_relaxed);
+        entry.keyXorData.store(zobristCode ^ data, std::memory_order_relaxed);
+    }
+};
+
+static void getLegalMoves(const ChessBoard& board, MoveList& legalMoves) {
+    MoveList moves;
+    board.getMoves(moves, TACTICAL_MOVES);
+    board.getMoves(moves, QUIET_MOVES);
+    for (move_t move : moves) {
+        if (board.isLegal(move))
+            legalMoves.push_back(move);
+    }
+}
+
+static perft_t fastPerftRecursive(const ChessBoard& board, depth_t depth, PerftHash& perftHash) {
+    // Step 1: Bulk count at depth 1
+    MoveList legalMoves;
+    getLegalMoves(board, legalMoves);
+    if (depth <= 1)
+        return depth <= 0 ? 1 : perft_t(legalMoves.size);
+
+    // Step 2: Probe the perft hash
+    perft_t count = 0;
+    if (perftHash.get(board.getZobristCode(), depth, count))
+        return count;
+
+    // Step 3: Recurse
+    for (move_t move : legalMoves) {
+        ChessBoard newBoard = board;
+        newBoard.makemove(move);
+        count += fastPerftRecursive(newBoard, depth_t(depth - 1), perftHash);
+    }
+
+    perftHash.put(board.getZobristCode(), depth, count);
+    return count;
+}
+
+perft_t fastPerft(const ChessBoard& board, depth_t depth, int threads, int hashMB, bool printSplit) {
+    // Step 1: Generate the root moves
+    MoveList rootMoves;
+    getLegalMoves(board, rootMoves);
+    if (depth <= 1) {
+        if (printSplit) {
+            for (move_t move : rootMoves)
+                std::cout << moveToLAN(move) << ": 1" << std::endl;
+        }
+        return depth <= 0 ? 1 : perft_t(rootMoves.size);
+    }
+
+    // Step 2: Split the root moves between the threads
+    // Every thread takes the next root move that nobody has taken yet, until there are none left
+    PerftHash perftHash(hashMB);
+    std::vector<perft_t> rootCounts(rootMoves.size, 0);
+    std::atomic<size_t> nextRootMove = 0;
+    const auto worker = [&] {
+        for (size_t i = nextRootMove++; i < rootMoves.size; i = nextRootMove++) {
+            ChessBoard newBoard = board;
+            newBoard.makemove(rootMoves.at(i));
+            rootCounts[i] = fastPerftRecursive(newBoard, depth_t(depth - 1), perftHash);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; i++)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread : workers)
+        thread.join();
+
+    // Step 3: Add up the counts
+    perft_t count = 0;
+    for (size_t i = 0; i < rootMoves.size; i++) {
+        if (printSplit)
+            std::cout << moveToLAN(rootMoves.at(i)) << ": " << rootCounts[i] << std::endl;
+        count += rootCounts[i];
+    }
+    return count;
+}
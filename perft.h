@@ -2,4 +2,10 @@
 
 #include "chessboard.h"
 
-perft_t perft(const ChessBoard& board, depth_t depth);
\ No newline at end of file
+perft_t perft(const ChessBoard& board, depth_t depth);
+
+// Perft for checking move generation at high depths, without any of the validation that perft does
+// Leaf nodes are bulk counted, subtrees are cached in a perft hash of hashMB megabytes,
+// and the root moves are split between threads
+// If printSplit is true, this prints the number of nodes after every root move (like "go perft" in other engines)
+perft_t fastPerft(const ChessBoard& board, depth_t depth, int threads, int hashMB, bool printSplit = false);
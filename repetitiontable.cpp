@@ -16,4 +16,12 @@ bool RepetitionTable::isRepeated(zobrist_t zobristCode) const {
             return true;
     }
     return false;
+}
+
+size_t RepetitionTable::size() const {
+    return positions.size();
+}
+
+zobrist_t RepetitionTable::getNthMostRecent(size_t n) const {
+    return positions[positions.size() - 1 - n];
 }
\ No newline at end of file
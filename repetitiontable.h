@@ -11,4 +11,8 @@ public:
     void clear();
     void insert(zobrist_t zobristCode);
     bool isRepeated(zobrist_t zobristCode) const;
+    [[nodiscard]] size_t size() const;
+    // Returns the zobrist code that was inserted n insertions ago, so n = 0 is the most recent one
+    // The behavior is undefined if n >= size()
+    [[nodiscard]] zobrist_t getNthMostRecent(size_t n) const;
 };
\ No newline at end of file
@@ -3,6 +3,9 @@
 #include "moveorder.h"
 #include "movegenerator.h"
 #include "hce.h"
+#include "cuckoo.h"
+#include "attacks.h"
+#include "syzygy.h"
 
 #include <iostream>
 #include <exception>
@@ -10,50 +13,116 @@
 #include <functional>
 #include <cmath>
 #include <algorithm>
+#include <bit>
+
+// These switch individual pruning techniques on and off, so that we can measure each of them at fixed depth with bench
+constexpr bool doRazoring = true;
+constexpr bool doFutilityPruning = true;
+constexpr bool doSEEPruning = true;
+constexpr bool doHistoryPruning = true;
+constexpr bool doProbCut = true;
 
 class SearchCancelledException : std::exception {
 
 };
 
-eval_t qsearch(sg::ThreadData& threadData, const ChessBoard& board, const depth_t ply, eval_t alpha, const eval_t beta, const move_t lastMove) {
-    // Step 1: Increment nodes
-    threadData.nodes++;
+// Gets the number of milliseconds since the search started
+inline int64_t getElapsedMs(const sg::ThreadData& threadData) {
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now - threadData.searchStartTime).count();
+}
+
+// Prints the depth, seldepth, nodes, nps, time, hashfull and tbhits parts of an info line, without a newline
+void printInfoStats(const sg::SearchContext& context, const sg::ThreadData& threadData, const int64_t msElapsed) {
+    std::cout << "info depth " << int(threadData.rootDepth) << " seldepth " << int(threadData.seldepth)
+              << " nodes " << threadData.nodes << " nps " << threadData.nodes * 1000 / std::max<int64_t>(msElapsed, 1)
+              << " time " << msElapsed << " hashfull " << context.tt.hashfull() << " tbhits " << threadData.tbHits;
+}
+
+// Throws a SearchCancelledException if the search has gone over the hard node limit or the hard time limit
+// The node limit is checked at every node, so that searches with the same node limit always search the same tree
+// We never cancel the search before there is a root best move
+// This also prints an info line every second, so that long iterations don't look like the engine is stuck
+inline void checkHardLimits(const sg::SearchContext& context, sg::ThreadData& threadData) {
+    if (threadData.nodes > context.limits.hardNodesLimit and threadData.rootBestMove != 0)
+        throw SearchCancelledException();
 
-    // Step 2: Check for hard time limit
     if (threadData.nodes % 1024 == 0) {
-        auto now = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - threadData.searchStartTime);
-        auto msElapsed = duration.count();
-        if (msElapsed >= sg::hardTimeLimit)
+        const int64_t msElapsed = getElapsedMs(threadData);
+        if (msElapsed >= context.limits.hardTimeLimit)
             throw SearchCancelledException();
+        if (threadData.printInfo and msElapsed - threadData.lastInfoTime >= 1000) {
+            threadData.lastInfoTime = msElapsed;
+            printInfoStats(context, threadData, msElapsed);
+            std::cout << std::endl;
+        }
+    }
+}
+
+eval_t qsearch(sg::SearchContext& context, sg::ThreadData& threadData, const ChessBoard& board, const depth_t ply, eval_t alpha, const eval_t beta, const move_t lastMove) {
+    // Step 1: Increment nodes
+    threadData.nodes++;
+    threadData.seldepth = std::max(threadData.seldepth, ply);
+    sg::addStat(threadData.stats.qsearchNodes);
+    if constexpr (sg::COLLECT_STATS)
+        threadData.stats.seldepth = std::max(threadData.stats.seldepth, int(ply));
+
+    // Step 2: Check for hard time and node limits
+    checkHardLimits(context, threadData);
+
+    // Step 3: Probe the TT
+    // Every entry has a depth of at least 0, so every entry is deep enough for a cutoff
+    const zobrist_t zobristCode = board.getZobristCode();
+    const TTEntry ttEntry = context.tt.get(zobristCode);
+    const move_t ttMove = ttEntry.ttMove;
+    const ttflag_t ttFlag = ttEntry.ttFlag;
+    const eval_t ttScore = sg::scoreFromTT(ttEntry.score, ply);
+    sg::addStat(threadData.stats.ttProbes);
+    sg::addStat(threadData.stats.ttHits, ttEntry.isNotNull());
+    if ((ttFlag == ttflags::EXACT) or
+    (ttFlag == ttflags::UPPER_BOUND and ttScore <= alpha) or
+    (ttFlag == ttflags::LOWER_BOUND and ttScore >= beta)) {
+        sg::addStat(threadData.stats.ttCutoffs);
+        return ttScore;
     }
 
-    // Step 3: Check stand-pat
+    // Step 4: Check stand-pat
+    // If the TT score is a bound in the right direction, it is a better guess than the static eval
     const eval_t staticEval = threadData.pawnCorrhist.getCorrectedEval(board.calcPawnKey(),
                                                                        hce::getStaticEval(board),
                                                                        board.getSTM());
     eval_t bestScore = staticEval;
+    if ((ttFlag == ttflags::LOWER_BOUND and ttScore > staticEval) or (ttFlag == ttflags::UPPER_BOUND and ttScore < staticEval))
+        bestScore = ttScore;
     if (bestScore >= beta)
         return bestScore;
+    const eval_t originalAlpha = alpha;
     if (bestScore > alpha)
         alpha = bestScore;
 
-    // Step 4: Get the move list, sorted by MVV-LVA
+    // Step 5: Get the move list, with the TT move first and the others sorted by MVV and capture history
     MoveList moves;
     board.getMoves(moves, TACTICAL_MOVES);
-    scoreMovesByMVVLVA(moves);
+    for (move_t& move : moves) {
+        if (move == ttMove)
+            move |= 1023 << 22;
+        else
+            move |= getTacticalScore(move, threadData.captureHistory[mvs::getPieceTo(move, board.getSTM())][mvs::getCapturedPiece(move)]) << 22;
+    }
     std::sort(moves.begin(), moves.end(), std::greater<>());
 
-    // Step 5: Search all the moves
+    // Step 6: Search all the moves
+    move_t bestMove = 0;
     for (move_t move : moves) {
         if (board.isLegal(move) and board.isGoodSEE(move)) {
             ChessBoard newBoard = board;
             newBoard.makemove(move);
-            eval_t newScore = -qsearch(threadData, newBoard, ply + 1, -beta, -alpha, move);
+            eval_t newScore = -qsearch(context, threadData, newBoard, ply + 1, -beta, -alpha, move);
             if (newScore > bestScore) {
                 bestScore = newScore;
                 if (newScore > alpha) {
                     alpha = newScore;
+                    bestMove = move;
                     if (newScore >= beta) {
                         break;
                     } // end if newScore >= beta
@@ -62,21 +131,82 @@ eval_t qsearch(sg::ThreadData& threadData, const ChessBoard& board, const depth_
         } // end if board.isLegal(move)
     } // end for loop over moves
 
+    // Step 7: Put something in the TT, at depth 0
+    const ttflag_t flagForTT = bestScore >= beta ? ttflags::LOWER_BOUND : (alpha > originalAlpha ? ttflags::EXACT : ttflags::UPPER_BOUND);
+    context.tt.put(zobristCode, bestMove, sg::scoreToTT(bestScore, ply), flagForTT, 0);
+
     return bestScore;
 }
 
-eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t depth, const depth_t ply, eval_t alpha, const eval_t beta, const move_t lastMove, bool cutnode) {
+// Returns true if the side to move has a reversible move that goes back to an earlier position
+// This lets us see a repetition draw one ply before it is actually on the board
+bool hasUpcomingRepetition(const sg::SearchContext& context, const sg::ThreadData& threadData, const ChessBoard& board, const depth_t ply) {
+    // Step 1: Find how far back we can look
+    // We can't go back past an irreversible move or a null move
+    int maxDistance = board.getHalfmove();
+    for (int distance = 0; distance < ply and distance < maxDistance; distance++) {
+        if (threadData.searchStack[ply - distance].move == 0)
+            maxDistance = distance;
+    }
+    if (maxDistance < 3)
+        return false;
+
+    // Step 2: Figure out if we can use the positions from before the root
+    // This is only possible if the root position is the last position inserted into the repetition table
+    const side_t stm = board.getSTM();
+    const side_t rootSTM = stm ^ (ply & 1);
+    const bool canUseHistory = context.repetitionTables[rootSTM].size() > 0 and
+                               context.repetitionTables[rootSTM].getNthMostRecent(0) == threadData.searchStack[0].zobristCode;
+
+    // Step 3: Loop over the earlier positions with the other side to move, looking for one we can reach in one move
+    const zobrist_t zobristCode = board.getZobristCode();
+    const bitboard_t allPieces = board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK);
+    for (int distance = 3; distance <= maxDistance; distance += 2) {
+        zobrist_t earlierCode;
+        if (distance <= ply) {
+            earlierCode = threadData.searchStack[ply - distance].zobristCode;
+        }
+        else {
+            // Positions before the root with the other side to move are 2 plies apart in the repetition table
+            const size_t n = (distance - ply) / 2;
+            if (!canUseHistory or n >= context.repetitionTables[stm ^ 1].size())
+                break;
+            earlierCode = context.repetitionTables[stm ^ 1].getNthMostRecent(n);
+        }
+
+        const move_t move = cuckoo::getMove(zobristCode ^ earlierCode);
+        if (move == 0)
+            continue;
+
+        // The move is only possible if there is nothing in between the two squares
+        const square_t from = mvs::getFrom(move);
+        const square_t to = mvs::getTo(move);
+        if (!(getAttackedSquares(from, mvs::getPiece(move), allPieces, stm) & 1ULL << to))
+            continue;
+
+        // At or before the root, the repetition has to come from one of our moves, like in Stockfish
+        // Otherwise the key difference could come from an opponent's piece, which we can't move back
+        if (distance >= ply) {
+            const square_t occupied = allPieces & 1ULL << from ? from : to;
+            if (!(board.getSideBB(stm) & 1ULL << occupied))
+                continue;
+        }
+        return true;
+    } // end for loop over distance
+
+    return false;
+} // end hasUpcomingRepetition function
+
+eval_t negamax(sg::SearchContext& context, sg::ThreadData& threadData, const ChessBoard& board, depth_t depth, const depth_t ply, eval_t alpha, eval_t beta, const move_t lastMove, bool cutnode) {
     // Step 1: Increment nodes
     threadData.nodes++;
+    threadData.seldepth = std::max(threadData.seldepth, ply);
+    sg::addStat(threadData.stats.mainNodes);
+    if constexpr (sg::COLLECT_STATS)
+        threadData.stats.seldepth = std::max(threadData.stats.seldepth, int(ply));
 
-    // Step 2: Check for hard time limit
-    if (threadData.nodes % 1024 == 0) {
-        auto now = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(now - threadData.searchStartTime);
-        auto msElapsed = duration.count();
-        if (msElapsed >= sg::hardTimeLimit)
-            throw SearchCancelledException();
-    }
+    // Step 2: Check for hard time and node limits
+    checkHardLimits(context, threadData);
 
     // Step 3: Initialize certain useful variables for search
     const bool isRoot = ply == 0;
@@ -87,82 +217,256 @@ eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t dept
     const bool pvNode = beta - alpha > 1;
     if (pvNode)
         cutnode = false;
+    const move_t excludedMove = threadData.searchStack[ply].excludedMove;
+    threadData.searchStack[ply].zobristCode = zobristCode;
+    threadData.searchStack[ply].move = lastMove;
+    if (isRoot)
+        threadData.searchStack[ply].doubleExtensions = 0;
 
     // Step 4: Check for game end conditions
     // Annoyingly, if there have been 50 moves since a capture or pawn move, and you are in checkmate, it's not a draw.
     if (is50mrDraw and !inCheck)
         return 0;
-    if (!isRoot and sg::repetitionTables[stm].isRepeated(zobristCode))
+    if (!isRoot and context.repetitionTables[stm].isRepeated(zobristCode))
         return 0;
+    // If we can repeat an earlier position, we can get at least a draw
+    if (!isRoot and alpha < 0 and hasUpcomingRepetition(context, threadData, board, ply)) {
+        alpha = 0;
+        if (alpha >= beta)
+            return alpha;
+    }
+    // Mate distance pruning: we can't do better than mating next move, or worse than getting mated right now
+    if (!isRoot) {
+        alpha = std::max<eval_t>(alpha, -sg::SCORE_MATE + ply);
+        beta = std::min<eval_t>(beta, sg::SCORE_MATE - ply - 1);
+        if (alpha >= beta)
+            return alpha;
+    }
 
     // Step 5: Probe the TT
-    const TTEntry ttEntry = sg::GLOBAL_TT.get(zobristCode);
+    const TTEntry ttEntry = context.tt.get(zobristCode);
     move_t ttMove = ttEntry.ttMove;
-    eval_t ttScore = ttEntry.score;
+    eval_t ttScore = sg::scoreFromTT(ttEntry.score, ply);
     ttflag_t ttFlag = ttEntry.ttFlag;
     depth_t ttDepth = ttEntry.depth;
+    sg::addStat(threadData.stats.ttProbes);
+    sg::addStat(threadData.stats.ttHits, ttEntry.isNotNull());
 
     // Step 6: Check for TT cutoffs
-    if (!isRoot and ttDepth >= depth) {
-        if (ttFlag == ttflags::EXACT)
-            return ttScore;
-        if (ttFlag == ttflags::UPPER_BOUND and ttScore <= alpha)
-            return ttScore;
-        if (ttFlag == ttflags::LOWER_BOUND and ttScore >= beta)
+    // The TT entry belongs to the search without the excluded move, so it can't cut off a singular verification search
+    if (!isRoot and excludedMove == 0 and ttDepth >= depth) {
+        if ((ttFlag == ttflags::EXACT) or
+        (ttFlag == ttflags::UPPER_BOUND and ttScore <= alpha) or
+        (ttFlag == ttflags::LOWER_BOUND and ttScore >= beta)) {
+            sg::addStat(threadData.stats.ttCutoffs);
             return ttScore;
+        }
     }
 
+    // Step 6A: Probe the tablebases
+    // We only probe right after a capture or pawn move, since the WDL tables don't know about the 50 move rule
+    const int pieceCount = std::popcount(board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK));
+    const int tbCardinality = std::min(syzygy::getLargest(), context.options.syzygyProbeLimit);
+    if (!isRoot and excludedMove == 0 and board.getHalfmove() == 0 and pieceCount <= tbCardinality and
+    (pieceCount < tbCardinality or depth >= context.options.syzygyProbeDepth)) {
+        const int wdl = syzygy::probeWDL(board);
+        if (wdl != syzygy::wdl::FAILED) {
+            threadData.tbHits++;
+            // Cursed wins and blessed losses are draws, but we score them slightly better or worse than a real draw
+            eval_t tbScore = wdl - syzygy::wdl::DRAW;
+            ttflag_t tbFlag = ttflags::EXACT;
+            if (wdl == syzygy::wdl::WIN) {
+                tbScore = sg::SCORE_TB_WIN - ply;
+                tbFlag = ttflags::LOWER_BOUND;
+            }
+            else if (wdl == syzygy::wdl::LOSS) {
+                tbScore = -sg::SCORE_TB_WIN + ply;
+                tbFlag = ttflags::UPPER_BOUND;
+            }
+
+            if (tbFlag == ttflags::EXACT or
+            (tbFlag == ttflags::LOWER_BOUND and tbScore >= beta) or
+            (tbFlag == ttflags::UPPER_BOUND and tbScore <= alpha)) {
+                context.tt.put(zobristCode, 0, sg::scoreToTT(tbScore, ply), tbFlag, std::min(depth + 6, int(sg::MAX_PLY)));
+                return tbScore;
+            }
+        } // end if the probe didn't fail
+    } // end if we can probe the tablebases
+
     // Step 7: Internal iterative reductions
     if (ttMove == 0 and depth > 3 and (pvNode or cutnode))
         depth--;
 
-    // Step 8: Check if depth is 0 or less
-    if (depth <= 0)
-        return qsearch(threadData, board, ply, alpha, beta, lastMove);
+    // Step 8: Check if depth is 0 or less, or if we are too deep into the search stack
+    if (depth <= 0 or ply >= sg::MAX_PLY)
+        return qsearch(context, threadData, board, ply, alpha, beta, lastMove);
 
     // Step 9: Try RFP
     const eval_t staticEval = hce::getStaticEval(board);
-    if (!inCheck and depth <= 5 and staticEval - 100 * depth >= beta)
-        return beta;
+    // We are improving if our static eval went up since our last move
+    const bool improving = !inCheck and ply >= 2 and staticEval > threadData.searchStack[ply - 2].staticEval;
+    if (!inCheck and excludedMove == 0 and depth <= 5) {
+        sg::addStat(threadData.stats.rfpTries);
+        if (staticEval - spsa::RFP_MARGIN * depth >= beta) {
+            sg::addStat(threadData.stats.rfpCutoffs);
+            return beta;
+        }
+    }
+
+    // Step 9A: Try razoring
+    if (doRazoring and !pvNode and !inCheck and excludedMove == 0 and
+    depth <= spsa::RAZORING_MAX_DEPTH and staticEval + spsa::RAZORING_MARGIN * depth < alpha) {
+        const eval_t razorScore = qsearch(context, threadData, board, ply, alpha, alpha + 1, lastMove);
+        if (razorScore <= alpha)
+            return razorScore;
+    }
 
     // Step 10: Try NMP
-    if (!isRoot and !sg::isMateScore(beta) and board.canTryNMP()) {
-        const depth_t R = 4 + depth / 5;
+    if (!isRoot and excludedMove == 0 and !sg::isMateScore(beta) and board.canTryNMP()) {
+        const depth_t R = spsa::NMP_BASE_REDUCTION + depth / spsa::NMP_DEPTH_DIVISOR;
         ChessBoard nmBoard = board;
         nmBoard.makeNullMove();
-        const eval_t nmScore = -negamax(threadData, nmBoard, depth - R, ply + 1, -beta, -beta + 1, 0, !cutnode);
+        sg::addStat(threadData.stats.nmpTries);
+        const eval_t nmScore = -negamax(context, threadData, nmBoard, depth - R, ply + 1, -beta, -beta + 1, 0, !cutnode);
         if (nmScore >= beta) {
+            sg::addStat(threadData.stats.nmpCutoffs);
             return nmScore;
         }
     }
 
+    // Step 10A: Try ProbCut
+    // If a capture beats beta by a margin at reduced depth, it will very likely beat beta at full depth
+    // We don't try this if the TT already tells us that the reduced search would fail
+    const eval_t probcutBeta = beta + spsa::PROBCUT_MARGIN;
+    if (doProbCut and !pvNode and !inCheck and excludedMove == 0 and
+    depth >= spsa::PROBCUT_MIN_DEPTH and !sg::isMateScore(beta) and
+    !(ttFlag != ttflags::EMPTY and ttDepth >= depth - spsa::PROBCUT_REDUCTION + 1 and ttScore < probcutBeta)) {
+        MoveList captures;
+        board.getMoves(captures, TACTICAL_MOVES);
+        for (move_t& move : captures)
+            move |= getTacticalScore(move, threadData.captureHistory[mvs::getPieceTo(move, stm)][mvs::getCapturedPiece(move)]) << 22;
+        std::sort(captures.begin(), captures.end(), std::greater<>());
+
+        for (move_t move : captures) {
+            move = mvs::removeScore(move);
+            if (!board.isLegal(move) or !board.isSEEAtLeast(move, std::max(0, probcutBeta - staticEval)))
+                continue;
+
+            ChessBoard newBoard = board;
+            newBoard.makemove(move);
+            // Step 10A.1: Check with qsearch first, because it is much cheaper than the verification search
+            eval_t probcutScore = -qsearch(context, threadData, newBoard, ply + 1, -probcutBeta, -probcutBeta + 1, move);
+            // Step 10A.2: Verify with a reduced depth search
+            if (probcutScore >= probcutBeta)
+                probcutScore = -negamax(context, threadData, newBoard, depth - spsa::PROBCUT_REDUCTION, ply + 1, -probcutBeta, -probcutBeta + 1, move, !cutnode);
+            if (probcutScore >= probcutBeta) {
+                context.tt.put(zobristCode, move, sg::scoreToTT(probcutScore, ply), ttflags::LOWER_BOUND, depth - spsa::PROBCUT_REDUCTION + 1);
+                return probcutScore;
+            }
+        } // end for loop over captures
+    } // end if we can try ProbCut
+
     // Step 11: Initialize variables for moves searched through
     MoveList movesTried;
-    MoveGenerator generator(threadData, board, ttMove);
+    MoveGenerator generator(threadData, board, ttMove, ply);
     eval_t newScore;
     eval_t bestScore = sg::SCORE_MIN;
     move_t bestMove = 0;
     int moveCount = 0;
     bool improvedAlpha = false;
 
-    // Step 12: Overwrite the current entry of the search stack
-    threadData.searchStack[ply].zobristCode = zobristCode;
-    threadData.searchStack[ply].move = lastMove;
+    // Step 12: Overwrite the static eval in the current entry of the search stack
+    // (the zobrist code and the move were already written when we entered the node)
     threadData.searchStack[ply].staticEval = staticEval;
 
     // Step 13: Search all the moves
     while (move_t move = generator.nextMove()) {
+        // If the tablebases told us which root moves keep the best result, we only search those
+        if (isRoot and !threadData.tbRootMoves.empty() and
+        std::find(threadData.tbRootMoves.begin(), threadData.tbRootMoves.end(), move) == threadData.tbRootMoves.end())
+            continue;
         // We first have to handle some annoying edge cases
         if (isRoot and depth == 1 and moveCount == 0)
             threadData.rootBestMove = move; // This is to make sure there is always a root best move
         if (is50mrDraw)
             return 0;
+        if (move == excludedMove)
+            continue;
+
+        // Prune moves that are unlikely to raise alpha
+        // We only do this once we have a score that isn't getting mated, so we can't prune our way into a fake mate
+        if (!isRoot and !sg::isMateScore(bestScore)) {
+            if (mvs::isQuiet(move)) {
+                const int lmrDepth = std::max(0, depth - sg::getBaseLMR(depth, moveCount + 1));
+                // Futility pruning
+                if (doFutilityPruning and !inCheck and lmrDepth <= spsa::FUTILITY_MAX_DEPTH and
+                staticEval + spsa::FUTILITY_BASE + spsa::FUTILITY_MULTIPLIER * lmrDepth + spsa::FUTILITY_IMPROVING * improving <= alpha)
+                    continue;
+                // History pruning
+                if (doHistoryPruning and depth <= spsa::HISTORY_PRUNING_MAX_DEPTH and
+                threadData.getQuietHistory(move, stm, ply) < -spsa::HISTORY_PRUNING_MULTIPLIER * depth)
+                    continue;
+                // SEE pruning for quiets
+                if (doSEEPruning and depth <= spsa::SEE_PRUNING_MAX_DEPTH and
+                !board.isSEEAtLeast(move, -spsa::SEE_QUIET_MULTIPLIER * depth))
+                    continue;
+            } // end if move is quiet
+            else {
+                // SEE pruning for tacticals
+                if (doSEEPruning and depth <= spsa::SEE_PRUNING_MAX_DEPTH and
+                !board.isSEEAtLeast(move, -spsa::SEE_TACTICAL_MULTIPLIER * depth * depth))
+                    continue;
+            } // end else (move is tactical)
+        } // end if we can prune moves
 
         ChessBoard newBoard = board;
         newBoard.makemove(move);
         movesTried.push_back(move);
         moveCount++;
 
+        // In long searches, tell the GUI which root move we are on
+        if (isRoot and threadData.printInfo) {
+            const int64_t msElapsed = getElapsedMs(threadData);
+            if (msElapsed >= 3000)
+                std::cout << "info depth " << int(depth) << " currmove " << moveToLAN(move) << " currmovenumber " << moveCount << std::endl;
+        }
+
+        // Extensions are only allowed up to twice the root depth, so that they can't make the search explode
+        int extension = 0;
+        if (!isRoot and ply < 2 * threadData.rootDepth) {
+            // Singular extensions: if every move except the TT move fails low against a bound a bit below the TT score,
+            // the TT move is the only good move and deserves to be searched deeper
+            if (depth >= 8 and
+            move == ttMove and
+            excludedMove == 0 and
+            ttDepth >= depth - 3 and
+            (ttFlag == ttflags::LOWER_BOUND or ttFlag == ttflags::EXACT) and
+            !sg::isMateScore(ttScore)) {
+                const eval_t singularBeta = ttScore - 2 * depth;
+                threadData.searchStack[ply].excludedMove = move;
+                const eval_t singularScore = negamax(context, threadData, board, (depth - 1) / 2, ply, singularBeta - 1, singularBeta, lastMove, cutnode);
+                threadData.searchStack[ply].excludedMove = 0;
+
+                if (singularScore < singularBeta) {
+                    extension = 1;
+                    // Double extensions are limited per ply so that the depth can't keep growing along a line
+                    if (!pvNode and singularScore < singularBeta - 20 and threadData.searchStack[ply].doubleExtensions < 6)
+                        extension = 2;
+                }
+                // Multicut: if some other move also beats beta, we can assume this node will fail high anyway
+                else if (singularBeta >= beta) {
+                    return singularBeta;
+                }
+            } // end if singular extension conditions are met
+
+            // Check extensions
+            else if (newBoard.isInCheck()) {
+                extension = 1;
+            }
+        } // end if extensions are allowed
+        const depth_t newDepth = depth - 1 + extension;
+        threadData.searchStack[ply + 1].doubleExtensions = threadData.searchStack[ply].doubleExtensions + (extension >= 2);
+
         int R = 1;
         bool doReducedSearch = depth > 2 and moveCount > 1;
         bool doZWS = moveCount > 1;
@@ -175,19 +479,25 @@ eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t dept
         }
 
         if (doReducedSearch) {
-            newScore = -negamax(threadData, newBoard, depth - R, ply + 1, -alpha - 1, -alpha, move, !cutnode);
+            sg::addStat(threadData.stats.lmrSearches);
+            newScore = -negamax(context, threadData, newBoard, newDepth - R + 1, ply + 1, -alpha - 1, -alpha, move, !cutnode);
             if (newScore <= alpha) {
                 doZWS = false;
                 doFullSearch = false;
             }
+            else {
+                sg::addStat(threadData.stats.lmrResearches);
+            }
         }
         if (doZWS) {
-            newScore = -negamax(threadData, newBoard, depth - 1, ply + 1, -alpha - 1, -alpha, move, !cutnode);
-            if (alpha < newScore and newScore < beta)
+            newScore = -negamax(context, threadData, newBoard, newDepth, ply + 1, -alpha - 1, -alpha, move, !cutnode);
+            if (alpha < newScore and newScore < beta) {
+                sg::addStat(threadData.stats.pvsResearches);
                 doFullSearch = true;
+            }
         }
         if (doFullSearch) {
-            newScore = -negamax(threadData, newBoard, depth - 1, ply + 1, -beta, -alpha, move, !cutnode);
+            newScore = -negamax(context, threadData, newBoard, newDepth, ply + 1, -beta, -alpha, move, !cutnode);
         }
 
         if (newScore > bestScore) {
@@ -198,8 +508,11 @@ eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t dept
                 alpha = newScore;
                 if (isRoot)
                     threadData.rootBestMove = move;
-                if (newScore >= beta)
+                if (newScore >= beta) {
+                    sg::addStat(threadData.stats.betaCutoffs);
+                    sg::addStat(threadData.stats.betaCutoffsByMoveIndex[std::min(moveCount, 8) - 1]);
                     break;
+                }
             } // end if newScore > alpha
         } // end if newScore > bestScore
 
@@ -208,33 +521,62 @@ eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t dept
             break;
     } // end for loop over moves
 
+    sg::addStat(threadData.stats.expandedNodes, moveCount > 0);
+    sg::addStat(threadData.stats.movesSearched, moveCount);
+
     // Step 14: Deal with checkmates and stalemates
+    // In a singular verification search, having no other moves just means the excluded move is singular
     if (moveCount == 0) {
-        bestScore = inCheck ? -sg::SCORE_MATE : 0;
+        if (excludedMove != 0)
+            return alpha;
+        bestScore = inCheck ? -sg::SCORE_MATE + ply : 0;
     }
 
-    // Step 15: Update history in case of a beta cutoff from a quiet move
+    // Step 15: Update history in case of a beta cutoff
     if (bestScore >= beta) {
-        const history_t bonus = std::clamp(depth * depth, -512, 511);
-        // Step 15A: bonus to cutoff move if it's quiet
+        const history_t bonus = std::clamp(depth * depth, -512, spsa::HISTORY_BONUS_MAX);
+        const move_t lastLastMove = ply > 0 ? threadData.searchStack[ply - 1].move : 0;
+        // Butterfly history, 1-ply continuation history and 2-ply continuation history all get the same update
+        const auto updateQuietHistories = [&](const move_t move, const int moveBonus) {
+            const int pieceTo = mvs::getPieceTo(move, stm);
+            sg::updateHistory(threadData.butterflyHistory[stm][mvs::getFromTo(move)], moveBonus);
+            if (lastMove != 0)
+                sg::updateHistory(threadData.continuationHistory[mvs::getPieceTo(lastMove, stm ^ 1)][pieceTo], moveBonus);
+            if (lastLastMove != 0)
+                sg::updateHistory(threadData.continuationHistory[mvs::getPieceTo(lastLastMove, stm)][pieceTo], moveBonus);
+        };
+
+        // Step 15A: bonus to cutoff move if it's quiet, and make it the killer and countermove
         if (mvs::isQuiet(bestMove)) {
-            const auto fromTo = mvs::getFromTo(bestMove);
-            threadData.butterflyHistory[stm][fromTo] += bonus - bonus * threadData.butterflyHistory[stm][fromTo] / 511;
+            updateQuietHistories(bestMove, bonus);
+            threadData.searchStack[ply].killer = bestMove;
+            if (lastMove != 0)
+                threadData.counterMoves[mvs::getPieceTo(lastMove, stm ^ 1)] = bestMove;
         } // end if best move is quiet
 
         // Step 15B: malus to all quiet moves before this that didn't cause a cutoff
         for (move_t move : movesTried) {
             if (mvs::isQuiet(move) and move != bestMove) {
-                const auto fromTo = mvs::getFromTo(move);
-                threadData.butterflyHistory[stm][fromTo] -= bonus + bonus * threadData.butterflyHistory[stm][fromTo] / 512;
+                updateQuietHistories(move, -bonus);
             } // end if move is quiet and is not the best move
         } // end for loop over moves tried
+
+        // Step 15C: bonus to the cutoff move if it's tactical, and malus to all other tactical moves we tried
+        for (move_t move : movesTried) {
+            if (mvs::isTactical(move)) {
+                history_t& entry = threadData.captureHistory[mvs::getPieceTo(move, stm)][mvs::getCapturedPiece(move)];
+                sg::updateHistory(entry, move == bestMove ? bonus : -bonus);
+            } // end if move is tactical
+        } // end for loop over moves tried
     } // end if bestScore >= beta
 
     // Step 16: Put something in the TT
+    // Singular verification searches don't store anything, because their result doesn't include the excluded move
+    if (excludedMove != 0)
+        return bestScore;
     const ttflag_t flagForTT = bestScore >= beta ? ttflags::LOWER_BOUND : (improvedAlpha ? ttflags::EXACT : ttflags::UPPER_BOUND);
     const move_t bestMoveForTT = improvedAlpha ? bestMove : 0;
-    sg::GLOBAL_TT.put(zobristCode, bestMoveForTT, bestScore, flagForTT, depth);
+    context.tt.put(zobristCode, bestMoveForTT, sg::scoreToTT(bestScore, ply), flagForTT, depth);
 
     // Step 17: Update corrhist
     if (!inCheck and
@@ -250,66 +592,90 @@ eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t dept
     return bestScore;
 }
 
-sg::ThreadData rootSearch(const ChessBoard board) {
+// Formats a score the way UCI wants it, e.g. "cp 35" or "mate -3"
+std::string scoreToUCI(const eval_t score) {
+    if (sg::isMateScore(score))
+        return "mate " + std::to_string(sg::getMateInMoves(score));
+    return "cp " + std::to_string(score);
+}
+
+void rootSearch(sg::SearchContext& context, sg::ThreadData& rootThreadData, const ChessBoard board, const bool printInfo) {
     // Step 1: Initialize thread data
-    sg::ThreadData rootThreadData;
+    uciopt::applyTunables(context.options);
+    rootThreadData.printInfo = printInfo;
     eval_t score = hce::getStaticEval(board);
     eval_t prevScore = score;
     std::string rootBestMove;
     bool cancelled = false;
+    if (std::popcount(board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK)) <= context.options.syzygyProbeLimit and
+    syzygy::probeRoot(board, rootThreadData.tbRootMoves))
+        rootThreadData.tbHits++;
 
     // Step 2: Iterative deepening search
-    for (depth_t depth = 1; depth <= sg::depthLimit and !cancelled; depth++) {
+    for (depth_t depth = 1; depth <= context.limits.depthLimit and !cancelled; depth++) {
         // Step 2.1: Do the search
+        rootThreadData.rootDepth = depth;
         try {
             bool inWindow = false;
             int failsLeft = 3;
             if (depth < 5 or sg::isMateScore(score))
                 failsLeft = 0;
-            eval_t lowerRadius = 50;
-            eval_t upperRadius = 50;
+            eval_t lowerRadius = spsa::ASPIRATION_RADIUS;
+            eval_t upperRadius = spsa::ASPIRATION_RADIUS;
             while (failsLeft and !inWindow) {
                 eval_t alpha = prevScore - lowerRadius;
                 eval_t beta = prevScore + upperRadius;
-                score = negamax(rootThreadData, board, depth_t(depth), depth_t(0), alpha, beta, 0, false);
+                score = negamax(context, rootThreadData, board, depth_t(depth), depth_t(0), alpha, beta, 0, false);
                 if (score <= alpha) {
                     lowerRadius *= 2;
                     failsLeft--;
+                    sg::addStat(rootThreadData.stats.aspirationResearches);
                 }
                 else if (score >= beta) {
                     upperRadius *= 2;
                     failsLeft--;
+                    sg::addStat(rootThreadData.stats.aspirationResearches);
                 }
                 else {
                     inWindow = true;
                 } // end else
             } // end while failsLeft and !inWindow
             if (failsLeft == 0)
-                score = negamax(rootThreadData, board, depth_t(depth), depth_t(0), sg::SCORE_MIN, sg::SCORE_MAX, 0, false);
+                score = negamax(context, rootThreadData, board, depth_t(depth), depth_t(0), sg::SCORE_MIN, sg::SCORE_MAX, 0, false);
             prevScore = score;
+            rootThreadData.rootScore = score;
         }
         catch (const SearchCancelledException& e) {
             cancelled = true;
         }
 
         // Step 2.2: Get elapsed time
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        auto msElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - rootThreadData.searchStartTime).count();
+        const int64_t msElapsed = getElapsedMs(rootThreadData);
 
         // Step 2.3: Print out stuff
         rootBestMove = moveToLAN(rootThreadData.rootBestMove);
 
-        std::cout << "info depth " << int(depth) << " nodes " << rootThreadData.nodes << " time " << msElapsed << " score cp " << score << " pv " << rootBestMove << std::endl;
+        if (printInfo) {
+            printInfoStats(context, rootThreadData, msElapsed);
+            std::cout << " score " << scoreToUCI(score) << " pv " << rootBestMove << std::endl;
+            rootThreadData.lastInfoTime = msElapsed;
+        }
 
-        // Step 2.4: Check for soft time/depth/nodes limit
-        if (msElapsed > sg::softTimeLimit or rootThreadData.nodes >= sg::nodesLimit)
+        // Step 2.4: Check for soft time/depth/nodes/mate limit
+        if (msElapsed > context.limits.softTimeLimit or rootThreadData.nodes >= context.limits.nodesLimit)
+            break;
+        if (context.limits.mateLimit > 0 and sg::isMateScore(score) and score > 0 and sg::getMateInMoves(score) <= context.limits.mateLimit)
             break;
 
     }
 
     // Step 3: Print out bestmove
-    std::cout << "bestmove " << rootBestMove << std::endl;
+    if (printInfo)
+        std::cout << "bestmove " << rootBestMove << std::endl;
+}
 
-    // Step 4: Return the thread data
+sg::ThreadData rootSearch(sg::SearchContext& context, const ChessBoard board, const bool printInfo) {
+    sg::ThreadData rootThreadData;
+    rootSearch(context, rootThreadData, board, printInfo);
     return rootThreadData;
 }
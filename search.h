@@ -3,6 +3,13 @@
 #include "searchglobals.h"
 #include "chessboard.h"
 
-eval_t negamax(sg::ThreadData& threadData, const ChessBoard& board, depth_t depth, depth_t ply, eval_t alpha, eval_t beta, move_t lastMove, bool cutnode);
+eval_t negamax(sg::SearchContext& context, sg::ThreadData& threadData, const ChessBoard& board, depth_t depth, depth_t ply, eval_t alpha, eval_t beta, move_t lastMove, bool cutnode);
 
-sg::ThreadData rootSearch(ChessBoard board);
\ No newline at end of file
+// Searches the position with iterative deepening until one of the limits in context.limits is hit,
+// with the options, TT and game history of context
+// If printInfo is false, nothing is printed, which is useful when we are not talking to a GUI
+sg::ThreadData rootSearch(sg::SearchContext& context, ChessBoard board, bool printInfo = true);
+
+// Same as above, but with a ThreadData that the caller owns, which has to be new or cleared
+// The results (rootBestMove, rootScore, stats, etc.) are left in threadData
+void rootSearch(sg::SearchContext& context, sg::ThreadData& threadData, ChessBoard board, bool printInfo = true);
@@ -1,24 +1,37 @@
 #include "searchglobals.h"
 
-namespace sg {
-    int softTimeLimit = 0;
-    int hardTimeLimit = 0;
-    int depthLimit = 100;
-    perft_t nodesLimit = INT64_MAX;
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
 
-    std::array<RepetitionTable, 2> repetitionTables{};
+void sg::SearchContext::setClockLimits(const int time, const int inc) {
+    // The time management parameters are tunables, so they have to be this engine's
+    uciopt::applyTunables(options);
+    if (options.nodestime > 0) {
+        // This makes the search independent of how fast the machine is
+        limits.nodesLimit = perft_t(spsa::calcSoftTimeLimit(time, inc)) * options.nodestime;
+        limits.hardNodesLimit = perft_t(spsa::calcHardTimeLimit(time, inc)) * options.nodestime;
+        limits.softTimeLimit = 1000000000;
+        limits.hardTimeLimit = 1000000000;
+    }
+    else {
+        limits.softTimeLimit = spsa::calcSoftTimeLimit(time, inc);
+        limits.hardTimeLimit = spsa::calcHardTimeLimit(time, inc);
+    }
+}
 
-    TT GLOBAL_TT;
+static int calcBaseLMR(int depth, int movesSearched) {
+    int R = spsa::LMR_BASE / 100.0 + std::log(depth) * std::log(movesSearched) / (spsa::LMR_DIVISOR / 100.0);
+    R = std::min(R, depth - 1);
+    R = std::max(R, 1);
+    return R;
 }
 
 std::array<std::array<int, 64>, 16> initLMRTable() {
     std::array<std::array<int, 64>, 16> table = {};
     for (int depth = 1; depth < 16; depth++) {
         for (int movesSearched = 1; movesSearched < 64; movesSearched++) {
-            int R = 0.75 + std::log(depth) * std::log(movesSearched) / 2.3;
-            R = std::min(R, depth - 1);
-            R = std::max(R, 1);
-            table[depth][movesSearched] = R;
+            table[depth][movesSearched] = calcBaseLMR(depth, movesSearched);
         } // end for loop over movesSearched
     } // end for loop over depth
     return table;
@@ -28,5 +41,70 @@ const static std::array<std::array<int, 64>, 16> LMR_TABLE = initLMRTable();
 
 
 int sg::getBaseLMR(int depth, int moveCount) {
+#ifdef SPSA_TUNING
+    // The LMR parameters can change at any time, so there is no table
+    return calcBaseLMR(std::clamp(depth, 1, 15), std::clamp(moveCount, 1, 63));
+#else
     return LMR_TABLE[std::min(depth,15)][std::min(moveCount,63)];
-}
\ No newline at end of file
+#endif
+}
+
+sg::SearchStats& sg::SearchStats::operator+=(const SearchStats& other) {
+    mainNodes += other.mainNodes;
+    qsearchNodes += other.qsearchNodes;
+    ttProbes += other.ttProbes;
+    ttHits += other.ttHits;
+    ttCutoffs += other.ttCutoffs;
+    betaCutoffs += other.betaCutoffs;
+    for (size_t i = 0; i < betaCutoffsByMoveIndex.size(); i++)
+        betaCutoffsByMoveIndex[i] += other.betaCutoffsByMoveIndex[i];
+    rfpTries += other.rfpTries;
+    rfpCutoffs += other.rfpCutoffs;
+    nmpTries += other.nmpTries;
+    nmpCutoffs += other.nmpCutoffs;
+    lmrSearches += other.lmrSearches;
+    lmrResearches += other.lmrResearches;
+    pvsResearches += other.pvsResearches;
+    aspirationResearches += other.aspirationResearches;
+    expandedNodes += other.expandedNodes;
+    movesSearched += other.movesSearched;
+    seldepth = std::max(seldepth, other.seldepth);
+    return *this;
+}
+
+void sg::SearchStats::print() const {
+    if constexpr (!COLLECT_STATS) {
+        std::cout << "Search statistics are disabled. Configure with -DSEARCH_STATS=ON to enable them." << std::endl;
+        return;
+    }
+
+    const auto percent = [](perft_t part, perft_t total) {
+        return total == 0 ? 0.0 : 100.0 * double(part) / double(total);
+    };
+
+    // The caller's formatting is restored at the end, since bench prints more numbers after this
+    const std::ios_base::fmtflags oldFlags = std::cout.flags();
+    const std::streamsize oldPrecision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "-------------SEARCH STATS-------------" << std::endl;
+    std::cout << "Main nodes: " << mainNodes << std::endl;
+    std::cout << "Qsearch nodes: " << qsearchNodes << " (" << percent(qsearchNodes, mainNodes + qsearchNodes) << "% of all nodes)" << std::endl;
+    std::cout << "TT hit rate: " << percent(ttHits, ttProbes) << "% of " << ttProbes << " probes" << std::endl;
+    std::cout << "TT cutoff rate: " << percent(ttCutoffs, ttProbes) << "% of probes" << std::endl;
+    std::cout << "Beta cutoffs: " << betaCutoffs << std::endl;
+    for (size_t i = 0; i < betaCutoffsByMoveIndex.size(); i++) {
+        std::cout << "    on move " << i + 1 << (i + 1 == betaCutoffsByMoveIndex.size() ? "+" : "") << ": "
+                  << percent(betaCutoffsByMoveIndex[i], betaCutoffs) << "%" << std::endl;
+    }
+    std::cout << "RFP success rate: " << percent(rfpCutoffs, rfpTries) << "% of " << rfpTries << " tries" << std::endl;
+    std::cout << "NMP success rate: " << percent(nmpCutoffs, nmpTries) << "% of " << nmpTries << " tries" << std::endl;
+    std::cout << "LMR success rate: " << 100.0 - percent(lmrResearches, lmrSearches) << "% of " << lmrSearches << " reduced searches" << std::endl;
+    std::cout << "LMR re-searches: " << lmrResearches << std::endl;
+    std::cout << "PVS re-searches: " << pvsResearches << std::endl;
+    std::cout << "Aspiration window re-searches: " << aspirationResearches << std::endl;
+    std::cout << "Average branching factor: " << (expandedNodes == 0 ? 0.0 : double(movesSearched) / double(expandedNodes)) << std::endl;
+    std::cout << "Seldepth: " << seldepth << std::endl;
+    std::cout << "--------------------------------------" << std::endl;
+    std::cout.flags(oldFlags);
+    std::cout.precision(oldPrecision);
+}
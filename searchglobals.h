@@ -3,55 +3,257 @@
 #include <chrono>
 #include <climits>
 #include <array>
+#include <memory>
+#include <vector>
+#include <cstdlib>
 
 #include "typedefs.h"
+#include "flags.h"
 #include "uciopt.h"
 #include "repetitiontable.h"
 #include "tt.h"
 #include "corrhist.h"
+#include "book.h"
 
 namespace sg {
     constexpr eval_t SCORE_MIN = -32767;
     constexpr eval_t SCORE_MAX = 32767;
     constexpr eval_t SCORE_MATE = 32700;
+    // Tablebase wins are scored below every mate score, but above any eval
+    constexpr eval_t SCORE_TB_WIN = 31000;
+
+    // Past this ply, negamax drops straight into qsearch so that the search stack can't overflow
+    constexpr depth_t MAX_PLY = 100;
 
     inline bool isMateScore(eval_t score) {
         return score > 32000 or score < -32000;
     }
 
+    // Mate and tablebase scores are counted from the root in search, but from the current position in the TT
+    // That way, a TT entry gives the right distance no matter which ply we find it at
+    // Tablebase scores are never more than MAX_PLY away from SCORE_TB_WIN, and mate scores are all above that
+    inline eval_t scoreToTT(eval_t score, depth_t ply) {
+        if (score >= SCORE_TB_WIN - MAX_PLY)
+            return score + ply;
+        if (score <= -SCORE_TB_WIN + MAX_PLY)
+            return score - ply;
+        return score;
+    }
+
+    inline eval_t scoreFromTT(eval_t score, depth_t ply) {
+        if (score >= SCORE_TB_WIN - MAX_PLY)
+            return score - ply;
+        if (score <= -SCORE_TB_WIN + MAX_PLY)
+            return score + ply;
+        return score;
+    }
+
+    // Gets how many moves until mate for a mate score, as in "score mate N"
+    // This is negative if the side to move is getting mated
+    inline int getMateInMoves(eval_t score) {
+        return score > 0 ? (SCORE_MATE - score + 1) / 2 : -(SCORE_MATE + score) / 2;
+    }
+
     struct SearchStackEntry {
         zobrist_t zobristCode = 0;
         eval_t staticEval = 0;
         move_t move = 0; // this is the move that lead to the position
+        move_t killer = 0; // this is the last quiet move that caused a beta cutoff at this ply
+        move_t excludedMove = 0; // this is the move we skip during a singular extension verification search
+        int doubleExtensions = 0; // this is the number of double extensions on the path from the root to this ply
     };
 
+    // Search statistics are only collected in builds configured with -DSEARCH_STATS=ON
+    // Otherwise addStat does nothing, so the counters cost nothing in normal builds
+#ifdef SEARCH_STATS
+    constexpr bool COLLECT_STATS = true;
+#else
+    constexpr bool COLLECT_STATS = false;
+#endif
+
+    inline void addStat(perft_t& counter, perft_t amount = 1) {
+        if constexpr (COLLECT_STATS)
+            counter += amount;
+    }
+
+    struct SearchStats {
+        perft_t mainNodes = 0;
+        perft_t qsearchNodes = 0;
+        perft_t ttProbes = 0;
+        perft_t ttHits = 0;
+        perft_t ttCutoffs = 0;
+        perft_t betaCutoffs = 0;
+        std::array<perft_t, 8> betaCutoffsByMoveIndex{}; // the last entry counts the 8th move and everything after it
+        perft_t rfpTries = 0;
+        perft_t rfpCutoffs = 0;
+        perft_t nmpTries = 0;
+        perft_t nmpCutoffs = 0;
+        perft_t lmrSearches = 0;
+        perft_t lmrResearches = 0; // reduced searches that beat alpha and had to be searched again at full depth
+        perft_t pvsResearches = 0; // zero window searches that landed inside the window and had to be searched again
+        perft_t aspirationResearches = 0;
+        perft_t expandedNodes = 0; // nodes where we searched at least one move
+        perft_t movesSearched = 0;
+        int seldepth = 0;
+
+        SearchStats& operator+=(const SearchStats& other);
+
+        // Prints out all the statistics in a human readable format
+        void print() const;
+    };
+
+    // Continuation history is indexed by [piece-to of an earlier move][piece-to of the current move]
+    // See mvs::getPieceTo
+    using ContinuationHistory = std::vector<std::array<history_t, 768>>;
+
     struct ThreadData {
         perft_t nodes = 0;
+        perft_t tbHits = 0;
+        depth_t seldepth = 0; // the highest ply we reached in this search, including qsearch
+        int64_t lastInfoTime = 0; // when we last printed an info line, in milliseconds since the search started
+        bool printInfo = true; // if this is false, the search doesn't print info lines or bestmove
+        SearchStats stats{};
         move_t rootBestMove = 0;
+        eval_t rootScore = 0; // the score of the last iteration that finished
+        depth_t rootDepth = 0;
         std::chrono::time_point<std::chrono::high_resolution_clock> searchStartTime = std::chrono::high_resolution_clock::now();
         std::array<SearchStackEntry, 128> searchStack{};
         std::array<std::array<history_t, 4096>, 2> butterflyHistory{};
+        ContinuationHistory continuationHistory = ContinuationHistory(768);
+        std::array<move_t, 768> counterMoves{}; // indexed by the piece-to of the previous move
+        std::array<std::array<history_t, 6>, 768> captureHistory{}; // indexed by [piece-to][captured piece]
         PawnCorrhist pawnCorrhist{};
+        std::vector<move_t> tbRootMoves; // if this is not empty, we only search these moves at the root
+
+        // Resets everything to how it is in a new ThreadData, without allocating the tables again
+        // This lets a thread that does many searches (like in evalbatch.cpp) reuse one ThreadData
+        void clear() {
+            nodes = 0;
+            tbHits = 0;
+            seldepth = 0;
+            lastInfoTime = 0;
+            printInfo = true;
+            stats = {};
+            rootBestMove = 0;
+            rootScore = 0;
+            rootDepth = 0;
+            searchStartTime = std::chrono::high_resolution_clock::now();
+            searchStack = {};
+            butterflyHistory = {};
+            for (std::array<history_t, 768>& row : continuationHistory)
+                row.fill(0);
+            counterMoves = {};
+            captureHistory = {};
+            pawnCorrhist.clear();
+            tbRootMoves.clear();
+        }
+
+        // Gets the butterfly history plus 1-ply and 2-ply continuation history of a quiet move
+        // This uses the moves on the search stack, so it only works after the node at this ply has been entered
+        [[nodiscard]] int getQuietHistory(move_t move, side_t stm, depth_t ply) const {
+            const move_t lastMove = searchStack[ply].move;
+            const move_t lastLastMove = ply > 0 ? searchStack[ply - 1].move : 0;
+            const int pieceTo = mvs::getPieceTo(move, stm);
+            int historyScore = butterflyHistory[stm][mvs::getFromTo(move)];
+            if (lastMove != 0)
+                historyScore += continuationHistory[mvs::getPieceTo(lastMove, stm ^ 1)][pieceTo];
+            if (lastLastMove != 0)
+                historyScore += continuationHistory[mvs::getPieceTo(lastLastMove, stm)][pieceTo];
+            return historyScore;
+        }
     };
 
-    // softTimeLimit and hardTimeLimit are measured in milliseconds
-    extern int softTimeLimit;
-    extern int hardTimeLimit;
-    extern int depthLimit;
-    extern perft_t nodesLimit;
+    // All of our history tables are kept between -512 and 512 by using history gravity
+    inline void updateHistory(history_t& entry, int bonus) {
+        entry += bonus - entry * std::abs(bonus) / 512;
+    }
+
+    struct SearchLimits {
+        // softTimeLimit and hardTimeLimit are measured in milliseconds
+        int softTimeLimit = 1000000000;
+        int hardTimeLimit = 1000000000;
+        int depthLimit = 100;
+        // nodesLimit is checked after every iteration, hardNodesLimit is checked at every node
+        perft_t nodesLimit = INT64_MAX;
+        perft_t hardNodesLimit = INT64_MAX;
+        // If mateLimit is not 0, we stop as soon as we find a mate in at most mateLimit moves
+        int mateLimit = 0;
+    };
+
+    // Everything one engine keeps between searches: its options, the limits of its next search, its TT,
+    // the positions of the game so far (for repetitions), and its opening book
+    // Every engine (the UCI loop, each side of a match, each datagen thread, each instance of the C API) has its own,
+    // so any number of independent searches can run in one process
+    struct SearchContext {
+        uciopt::Options options;
+        SearchLimits limits;
+        std::array<RepetitionTable, 2> repetitionTables{};
+        TT tt;
+        std::shared_ptr<const book::Book> book; // set with the Book option, and used if options.ownBook is true
 
-    extern std::array<RepetitionTable, 2> repetitionTables;
+        explicit SearchContext(const uciopt::Options& options = {}) : options(options), tt(options.hash) {}
 
-    extern TT GLOBAL_TT;
+        // Sets the time limits for a search with time ms left on the clock and inc ms of increment
+        // With the nodestime option, the clock is a node budget instead, so the node limits are set instead
+        void setClockLimits(int time, int inc);
+    };
 
     int getBaseLMR(int depth, int moveCount);
 }
 
+// Search parameters, see SPSA_PARAM in uciopt.h
+// SPSA_PARAM(NAME, default, min, max, step)
 namespace spsa {
+    // Time management: the soft limit is checked after every iteration, and the hard limit during the search
+    SPSA_PARAM(SOFT_TIME_DIVISOR, 20, 10, 40, 2)
+    SPSA_PARAM(SOFT_TIME_INC_PERCENT, 50, 20, 100, 5)
+    SPSA_PARAM(HARD_TIME_DIVISOR, 3, 2, 10, 1)
+
     inline int calcSoftTimeLimit(int time, int inc) {
-        return time / 20 + inc / 2;
+        return time / SOFT_TIME_DIVISOR + inc * SOFT_TIME_INC_PERCENT / 100;
     }
     inline int calcHardTimeLimit(int time, int inc) {
-        return time / 3;
+        return time / HARD_TIME_DIVISOR;
     }
+
+    // Aspiration windows start this far from the last score on each side
+    SPSA_PARAM(ASPIRATION_RADIUS, 50, 10, 100, 5)
+
+    // Reverse futility pruning: fail high if the static eval is above beta by at least RFP_MARGIN * depth
+    SPSA_PARAM(RFP_MARGIN, 100, 40, 200, 10)
+
+    // Null move pruning reduces by NMP_BASE_REDUCTION + depth / NMP_DEPTH_DIVISOR
+    SPSA_PARAM(NMP_BASE_REDUCTION, 4, 2, 6, 1)
+    SPSA_PARAM(NMP_DEPTH_DIVISOR, 5, 2, 10, 1)
+
+    // Late move reductions are LMR_BASE / 100 + ln(depth) * ln(moveCount) / (LMR_DIVISOR / 100)
+    SPSA_PARAM(LMR_BASE, 75, 25, 150, 10)
+    SPSA_PARAM(LMR_DIVISOR, 230, 150, 350, 15)
+
+    // History bonuses are depth * depth, up to this
+    SPSA_PARAM(HISTORY_BONUS_MAX, 511, 128, 511, 32)
+
+    // Razoring: at low depth, if the static eval is far below alpha, check with qsearch if we can fail low right away
+    SPSA_PARAM(RAZORING_MAX_DEPTH, 3, 1, 6, 1)
+    SPSA_PARAM(RAZORING_MARGIN, 250, 100, 500, 25)
+
+    // Futility pruning: at low depth, skip quiet moves if the static eval plus a margin is below alpha
+    SPSA_PARAM(FUTILITY_MAX_DEPTH, 8, 4, 12, 1)
+    SPSA_PARAM(FUTILITY_BASE, 100, 0, 200, 10)
+    SPSA_PARAM(FUTILITY_MULTIPLIER, 100, 40, 200, 10)
+    SPSA_PARAM(FUTILITY_IMPROVING, 50, 0, 150, 10)
+
+    // SEE pruning: at low depth, skip moves that lose too much material
+    SPSA_PARAM(SEE_PRUNING_MAX_DEPTH, 8, 4, 12, 1)
+    SPSA_PARAM(SEE_QUIET_MULTIPLIER, 60, 20, 120, 5)
+    SPSA_PARAM(SEE_TACTICAL_MULTIPLIER, 25, 10, 60, 3)
+
+    // History pruning: at low depth, skip quiet moves with bad history
+    SPSA_PARAM(HISTORY_PRUNING_MAX_DEPTH, 4, 1, 8, 1)
+    SPSA_PARAM(HISTORY_PRUNING_MULTIPLIER, 256, 64, 512, 32)
+
+    // ProbCut: at high depth, try to prove a beta cutoff with captures at reduced depth against a raised beta
+    SPSA_PARAM(PROBCUT_MIN_DEPTH, 5, 3, 8, 1)
+    SPSA_PARAM(PROBCUT_MARGIN, 150, 50, 300, 15)
+    SPSA_PARAM(PROBCUT_REDUCTION, 4, 2, 6, 1)
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "syzygy.h"
+
+#include <iostream>
+
+#ifdef USE_FATHOM
+#include <bit>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+#include "tbprobe.h"
+
+// Fathom's WDL probes can run in parallel, but tb_probe_root can't, and tb_init frees the tables that probes read
+// So probeWDL takes a shared lock, and probeRoot and init take an exclusive one
+static std::shared_mutex tbMutex;
+
+// A copy of TB_LARGEST that searches can read without the lock, since init changes it
+static std::atomic<int> largest = 0;
+
+// Our squares are file * 8 + rank, but Fathom's are rank * 8 + file
+// So we need to flip bitboards along the a1-h8 diagonal
+static uint64_t toFathomBB(bitboard_t bb) {
+    const bitboard_t k1 = 0x5500550055005500ULL;
+    const bitboard_t k2 = 0x3333000033330000ULL;
+    const bitboard_t k4 = 0x0f0f0f0f00000000ULL;
+    bitboard_t t = k4 & (bb ^ (bb << 28));
+    bb ^= t ^ (t >> 28);
+    t = k2 & (bb ^ (bb << 14));
+    bb ^= t ^ (t >> 14);
+    t = k1 & (bb ^ (bb << 7));
+    bb ^= t ^ (t >> 7);
+    return bb;
+}
+
+static square_t fromFathomSquare(unsigned square) {
+    return squares::squareFromFileRank(square & 7, square >> 3);
+}
+
+// Fathom wants the en passant target square, or 0 if there is none
+static unsigned getFathomEP(const ChessBoard& board) {
+    const uint8_t epCastlingRights = board.getEPCastlingRights();
+    if (!rights::isEPPossible(epCastlingRights))
+        return 0;
+    const unsigned file = rights::extractEPRights(epCastlingRights);
+    const unsigned rank = board.getSTM() == sides::WHITE ? 5 : 2;
+    return rank * 8 + file;
+}
+
+static bool hasCastlingRights(const ChessBoard& board) {
+    return board.getEPCastlingRights() & 0xf0;
+}
+
+void syzygy::init(const std::string& path) {
+    const std::unique_lock lock(tbMutex);
+    tb_free();
+    largest = 0;
+    if (path.empty() or path == "<empty>")
+        return;
+    const bool loaded = tb_init(path.c_str());
+    largest = int(TB_LARGEST);
+    if (!loaded)
+        std::cout << "info string failed to load Syzygy tablebases from " << path << std::endl;
+    else
+        std::cout << "info string found Syzygy tablebases with up to " << TB_LARGEST << " pieces" << std::endl;
+}
+
+int syzygy::getLargest() {
+    return largest;
+}
+
+int syzygy::probeWDL(const ChessBoard& board) {
+    if (board.getHalfmove() != 0 or hasCastlingRights(board))
+        return wdl::FAILED;
+
+    const std::shared_lock lock(tbMutex);
+    const unsigned result = tb_probe_wdl(toFathomBB(board.getSideBB(sides::WHITE)),
+                                         toFathomBB(board.getSideBB(sides::BLACK)),
+                                         toFathomBB(board.getPieceBB(pcs::KING)),
+                                         toFathomBB(board.getPieceBB(pcs::QUEEN)),
+                                         toFathomBB(board.getPieceBB(pcs::ROOK)),
+                                         toFathomBB(board.getPieceBB(pcs::BISHOP)),
+                                         toFathomBB(board.getPieceBB(pcs::KNIGHT)),
+                                         toFathomBB(board.getPieceBB(pcs::PAWN)),
+                                         0, 0, getFathomEP(board), board.getSTM() == sides::WHITE);
+    if (result == TB_RESULT_FAILED)
+        return wdl::FAILED;
+    return int(result);
+}
+
+bool syzygy::probeRoot(const ChessBoard& board, std::vector<move_t>& rootMoves) {
+    rootMoves.clear();
+    if (hasCastlingRights(board) or std::popcount(board.getSideBB(sides::WHITE) | board.getSideBB(sides::BLACK)) > getLargest())
+        return false;
+
+    // Step 1: Probe the root
+    // Only one thread can do this at a time, since Fathom keeps the root probe's state in globals
+    unsigned results[TB_MAX_MOVES];
+    std::unique_lock lock(tbMutex);
+    const unsigned result = tb_probe_root(toFathomBB(board.getSideBB(sides::WHITE)),
+                                          toFathomBB(board.getSideBB(sides::BLACK)),
+                                          toFathomBB(board.getPieceBB(pcs::KING)),
+                                          toFathomBB(board.getPieceBB(pcs::QUEEN)),
+                                          toFathomBB(board.getPieceBB(pcs::ROOK)),
+                                          toFathomBB(board.getPieceBB(pcs::BISHOP)),
+                                          toFathomBB(board.getPieceBB(pcs::KNIGHT)),
+                                          toFathomBB(board.getPieceBB(pcs::PAWN)),
+                                          board.getHalfmove(), 0, getFathomEP(board), board.getSTM() == sides::WHITE,
+                                          results);
+    lock.unlock();
+    if (result == TB_RESULT_FAILED or result == TB_RESULT_CHECKMATE or result == TB_RESULT_STALEMATE)
+        return false;
+
+    // Step 2: Find the best result, and the best DTZ with that result
+    // Fathom gives the absolute value of the DTZ, so when winning we want it low and when losing we want it high
+    unsigned bestWDL = TB_LOSS;
+    for (int i = 0; results[i] != TB_RESULT_FAILED; i++)
+        bestWDL = std::max(bestWDL, TB_GET_WDL(results[i]));
+    const bool isWinning = bestWDL == TB_WIN or bestWDL == TB_CURSED_WIN;
+    unsigned bestDTZ = isWinning ? UINT32_MAX : 0;
+    for (int i = 0; results[i] != TB_RESULT_FAILED; i++) {
+        if (TB_GET_WDL(results[i]) == bestWDL)
+            bestDTZ = isWinning ? std::min(bestDTZ, TB_GET_DTZ(results[i])) : std::max(bestDTZ, TB_GET_DTZ(results[i]));
+    }
+
+    // Step 3: Translate the moves that keep the best result into our moves
+    constexpr piece_t FATHOM_PROMOTIONS[5] = {0, pcs::QUEEN, pcs::ROOK, pcs::BISHOP, pcs::KNIGHT};
+    for (int i = 0; results[i] != TB_RESULT_FAILED; i++) {
+        if (TB_GET_WDL(results[i]) != bestWDL)
+            continue;
+        if (bestWDL != TB_DRAW and TB_GET_DTZ(results[i]) != bestDTZ)
+            continue;
+        const square_t from = fromFathomSquare(TB_GET_FROM(results[i]));
+        const square_t to = fromFathomSquare(TB_GET_TO(results[i]));
+        const unsigned promotes = TB_GET_PROMOTES(results[i]);
+        for (move_t move : board.getPseudoLegalMoves()) {
+            if (mvs::getFrom(move) == from and mvs::getTo(move) == to and board.isLegal(move) and
+            (promotes == TB_PROMOTES_NONE ? !mvs::isPromotion(move) : mvs::isPromotion(move) and mvs::getPromotedPiece(move) == FATHOM_PROMOTIONS[promotes])) {
+                rootMoves.push_back(move);
+                break;
+            }
+        } // end for loop over our moves
+    } // end for loop over results
+
+    return !rootMoves.empty();
+}
+
+#else
+
+void syzygy::init(const std::string& path) {
+    if (!path.empty() and path != "<empty>")
+        std::cout << "info string this build was compiled without Syzygy support (see syzygy.h)" << std::endl;
+}
+
+int syzygy::getLargest() {
+    return 0;
+}
+
+int syzygy::probeWDL(const ChessBoard&) {
+    return wdl::FAILED;
+}
+
+bool syzygy::probeRoot(const ChessBoard&, std::vector<move_t>& rootMoves) {
+    rootMoves.clear();
+    return false;
+}
+
+#endif
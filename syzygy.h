@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "chessboard.h"
+
+// Syzygy endgame tablebase probing
+// The tablebase files are read (memory-mapped) by Fathom, which is not part of this repository
+// Build with -DFATHOM_DIR=<path to a Fathom checkout> to enable probing; otherwise every probe fails
+namespace syzygy {
+    // Probe results, from the point of view of the side to move
+    // A cursed win is a win that the 50 move rule turns into a draw, and a blessed loss is the opposite
+    namespace wdl {
+        constexpr int FAILED = -1;
+        constexpr int LOSS = 0;
+        constexpr int BLESSED_LOSS = 1;
+        constexpr int DRAW = 2;
+        constexpr int CURSED_WIN = 3;
+        constexpr int WIN = 4;
+    }
+
+    // Loads the tablebases in path (several directories can be separated by ':' on Linux or ';' on Windows)
+    // An empty path or "<empty>" unloads them
+    // This waits for probes in other threads to finish first, so it is safe to call while another engine is searching
+    void init(const std::string& path);
+
+    // Gets the largest number of pieces (including kings) that we have tablebases for, or 0 if none are loaded
+    int getLargest();
+
+    // Probes the WDL tables
+    // This only works if there are no castling rights and the last move was a capture or pawn move,
+    // otherwise it returns wdl::FAILED
+    int probeWDL(const ChessBoard& board);
+
+    // Probes the DTZ tables at the root and fills rootMoves with the moves that keep the best result
+    // Among winning moves, only the ones with the lowest DTZ are kept, so that we always make progress
+    // Returns false and leaves rootMoves empty if the probe fails
+    // Fathom's root probe is not thread-safe, so concurrent calls take turns
+    bool probeRoot(const ChessBoard& board, std::vector<move_t>& rootMoves);
+}
@@ -9,6 +9,8 @@
 #include <utility>
 #include <functional>
 #include <ios>
+#include <cstdlib>
+#include <thread>
 
 #include "flags.h"
 #include "chessboard.h"
@@ -18,6 +20,10 @@
 #include "tt.h"
 #include "movegenerator.h"
 #include "hce.h"
+#include "cuckoo.h"
+#include "packedboard.h"
+#include "book.h"
+#include "syzygy.h"
 
 // I don't think this is really necessary
 // But why not leave it in
@@ -613,9 +619,11 @@ void runEasyPuzzleTestSuite(const std::string& bookFilename, const std::string&
     int numFailed = 0;
 
     if (passed) {
+        sg::SearchContext context;
+        context.limits.depthLimit = 10;
         for (int i = 0; i < boards.size(); i++) {
             ChessBoard board = boards[i];
-            sg::ThreadData data = rootSearch(board);
+            sg::ThreadData data = rootSearch(context, board);
             std::string searchBestMove = moveToLAN(data.rootBestMove);
             bestMove = bestMoves[i];
 
@@ -668,7 +676,7 @@ void printFenMoveOrder(const std::string& fen) {
 }
 
 void manualTTTest() {
-    TT tt;
+    TT tt(uciopt::HASH_DEFAULT);
     tt.put(1234567890ULL, mvs::constructMove(9,11,flags::DOUBLE_PAWN_PUSH_FLAG, pcs::PAWN, pcs::PAWN), 100, 1, 6);
 
     tt.put(809765213ULL, mvs::constructMove(squares::e8,squares::c8,flags::LONG_CASTLE_FLAG, pcs::KING, 0), -349, 3, 9); // Index collision
@@ -760,13 +768,199 @@ void canTryNMPTests() {
 
 void stagedMovegenKiwipeteTest() {
     ChessBoard board = ChessBoard::fromFEN("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1");
-    MoveGenerator generator(sg::ThreadData(), board, 0);
+    sg::ThreadData threadData;
+    MoveGenerator generator(threadData, board, 0, 0);
     std::cout << "KIWIPETE STAGED MOVEGEN MOVE ORDER: " << std::endl;
     while (move_t move = generator.nextMove()) {
         std::cout << moveToLAN(move) << std::endl;
     }
 }
 
+void cuckooTableTest() {
+    // There are 1834 reversible piece moves for each side, so 3668 in total since the table has both colors
+    const int numMoves = cuckoo::countMoves();
+    if (numMoves == 3668)
+        std::cout << "PASSED cuckoo table test" << std::endl;
+    else
+        std::cout << "FAILED cuckoo table test: expected 3668 moves, found " << numMoves << std::endl;
+}
+
+void seeThresholdTests() {
+    // Each test is a position, a move, and the exact SEE of the move, using the values in chessboard.cpp
+    struct SEETest {
+        std::string fen;
+        std::string move;
+        int see;
+    };
+    const std::array<SEETest, 4> seeTests = {{
+        {"1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - - 0 1", "e1e5", 100}, // undefended pawn
+        {"1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - - 0 1", "d3e5", -200}, // knight for pawn, with x-rays
+        {"4k3/8/8/4p3/8/8/8/3RK3 w - - 0 1", "d1d4", -500}, // quiet move to a square attacked by a pawn
+        {"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1", "e5d6", 100}, // en passant
+    }};
+
+    for (const SEETest& test : seeTests) {
+        const ChessBoard board = ChessBoard::fromFEN(test.fen);
+        const move_t move = board.parseLANMove(test.move);
+        if (board.isSEEAtLeast(move, test.see) and !board.isSEEAtLeast(move, test.see + 1))
+            std::cout << "PASSED SEE test " << test.move << std::endl;
+        else
+            std::cout << "FAILED SEE test " << test.fen << " " << test.move << ": expected " << test.see << std::endl;
+    }
+}
+
+void fastPerftTests() {
+    // These are the standard perft positions from the Chess Programming Wiki
+    struct FastPerftTest {
+        std::string fen;
+        depth_t depth;
+        perft_t nodes;
+    };
+    const std::array<FastPerftTest, 5> fastPerftTests = {{
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5, 4865609},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 4, 4085603},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 5, 674624},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+    }};
+
+    for (const FastPerftTest& test : fastPerftTests) {
+        const perft_t observed = fastPerft(ChessBoard::fromFEN(test.fen), test.depth, 4, 16);
+        if (observed == test.nodes)
+            std::cout << "PASSED fast perft for " << test.fen << " at depth " << int(test.depth) << std::endl;
+        else
+            std::cout << "FAILED fast perft for " << test.fen << " at depth " << int(test.depth) << ". Expected " << test.nodes << " nodes, observed " << observed << std::endl;
+    }
+}
+
+void packedBoardTests() {
+    // Each line should survive EPD -> packed -> file -> EPD unchanged
+    const std::array<std::string, 4> lines = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1 [0.5] 0",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1 [1] 123",
+        "rnbqnrk1/ppp3bp/3p2p1/3Ppp2/2P1P3/2N1BP2/PP1Q2PP/R3KBNR w KQ f6 0 9 [0] -45",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - - 57 80 [0.5] 2",
+    };
+    const std::string filename = "packed_board_test.bin";
+
+    // Step 1: Check the conversion of each position
+    std::ofstream file(filename, std::ios::binary);
+    for (const std::string& line : lines) {
+        PackedBoard packedBoard{};
+        const bool parsed = packed::fromEPD(line, packedBoard);
+        const ChessBoard board = ChessBoard::fromFEN(line.substr(0, line.find('[')));
+        if (parsed and packed::toEPD(packedBoard) == line and ChessBoard::fromPacked(packedBoard).getZobristCode() == board.getZobristCode())
+            std::cout << "PASSED packed board test " << line << std::endl;
+        else
+            std::cout << "FAILED packed board test " << line << ": got " << packed::toEPD(packedBoard) << std::endl;
+        file.write(reinterpret_cast<const char*>(&packedBoard), sizeof(PackedBoard));
+    }
+    file.close();
+
+    // Step 2: Check that the memory-mapped reader gives back the same positions
+    const packed::Reader reader(filename);
+    bool readerPassed = reader.isOpen() and reader.size() == lines.size();
+    for (size_t i = 0; readerPassed and i < lines.size(); i++)
+        readerPassed = packed::toEPD(reader[i]) == lines[i];
+    std::cout << (readerPassed ? "PASSED" : "FAILED") << " packed board reader test" << std::endl;
+    std::remove(filename.c_str());
+}
+
+void bookMoveEncodingTests() {
+    // Each move should have the Polyglot encoding, and decode back to itself
+    struct BookMoveTest {
+        std::string fen;
+        std::string move;
+        uint16_t bookMove;
+    };
+    const std::array<BookMoveTest, 4> tests = {{
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", "e2e4", 0x031c},
+        {"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1", "e1g1", 0x0107}, // castling is stored as e1h1
+        {"r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1", "e8c8", 0x0f38}, // castling is stored as e8a8
+        {"8/P7/8/8/8/8/k7/4K3 w - - 0 1", "a7a8n", 0x1c38},
+    }};
+
+    for (const BookMoveTest& test : tests) {
+        const ChessBoard board = ChessBoard::fromFEN(test.fen);
+        const move_t decoded = book::decodeMove(board, test.bookMove);
+        if (decoded != 0 and moveToLAN(decoded) == test.move and book::encodeMove(decoded) == test.bookMove)
+            std::cout << "PASSED book move test " << test.move << std::endl;
+        else
+            std::cout << "FAILED book move test " << test.move << ": decoded " << (decoded ? moveToLAN(decoded) : "0000") << std::endl;
+    }
+}
+
+void bookKeyTests() {
+    // Step 1: The keys should match the examples in the Polyglot book format description
+    struct BookKeyTest {
+        std::string fen;
+        zobrist_t key;
+    };
+    const std::array<BookKeyTest, 9> tests = {{
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 0x463b96181691fc9cULL},
+        {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823c9b50fd114196ULL},
+        {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756b94461c50fb0ULL},
+        {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662fafb965db29d4ULL},
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22a48b5a8e47ff78ULL}, // e5 can take f6
+        {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 0 3", 0x652a607ca3f242c1ULL},
+        {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 0 4", 0x00fdd303c946bdd9ULL},
+        {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3c8123ea7b067637ULL},
+        {"rnbqkbnr/p1pppppp/8/8/P6P/R1p5/1P1PPPP1/1NBQKBNR b Kkq - 0 4", 0x5c3f9b829b279560ULL},
+    }};
+    for (const BookKeyTest& test : tests) {
+        const zobrist_t key = book::getKey(ChessBoard::fromFEN(test.fen));
+        if (key == test.key)
+            std::cout << "PASSED book key test " << test.fen << std::endl;
+        else
+            std::cout << "FAILED book key test " << test.fen << ": got " << std::hex << key << std::dec << std::endl;
+    }
+
+    // Step 2: A book written by hand with the Polyglot startpos key should give its move at the start
+    // This is 0x463b96181691fc9c, then e2e4 (0x031c), weight 1 and learn 0, all big-endian
+    const std::string filename = "book_key_test.bin";
+    const std::array<uint8_t, book::ENTRY_BYTES> entry = {0x46, 0x3b, 0x96, 0x18, 0x16, 0x91, 0xfc, 0x9c, 0x03, 0x1c, 0x00, 0x01, 0, 0, 0, 0};
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(entry.data()), std::streamsize(entry.size()));
+    file.close();
+    const move_t bookMove = book::Book(filename).probe(ChessBoard::startpos(), true);
+    std::cout << (bookMove != 0 and moveToLAN(bookMove) == "e2e4" ? "PASSED" : "FAILED") << " book probe test" << std::endl;
+    std::remove(filename.c_str());
+}
+
+#ifdef USE_FATHOM
+void syzygyProbeTests() {
+    // This needs the 3 piece tablebases, in the directory given by the SYZYGY_PATH environment variable
+    const char* path = std::getenv("SYZYGY_PATH");
+    syzygy::init(path != nullptr ? path : "syzygy");
+    if (syzygy::getLargest() < 3) {
+        std::cout << "FAILED syzygy probe tests: couldn't load the 3 piece tablebases" << std::endl;
+        return;
+    }
+
+    // Step 1: WDL probes, from the point of view of the side to move
+    const ChessBoard whiteToMove = ChessBoard::fromFEN("4k3/8/8/8/8/8/8/4K2Q w - - 0 1");
+    const ChessBoard blackToMove = ChessBoard::fromFEN("4k3/8/8/8/8/8/8/4K2Q b - - 0 1");
+    const ChessBoard withCastlingRights = ChessBoard::fromFEN("4k3/8/8/8/8/8/8/R3K3 w Q - 0 1");
+    std::cout << (syzygy::probeWDL(whiteToMove) == syzygy::wdl::WIN ? "PASSED" : "FAILED") << " syzygy WDL win test" << std::endl;
+    std::cout << (syzygy::probeWDL(blackToMove) == syzygy::wdl::LOSS ? "PASSED" : "FAILED") << " syzygy WDL loss test" << std::endl;
+    std::cout << (syzygy::probeWDL(withCastlingRights) == syzygy::wdl::FAILED ? "PASSED" : "FAILED") << " syzygy castling rights test" << std::endl;
+
+    // Step 2: Root probes from several threads at once should all give the same moves
+    constexpr int THREADS = 4;
+    std::vector<std::vector<move_t>> rootMoves(THREADS);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < THREADS; i++)
+        threads.emplace_back([&, i]() { syzygy::probeRoot(whiteToMove, rootMoves[i]); });
+    for (std::thread& thread : threads)
+        thread.join();
+    bool rootPassed = !rootMoves[0].empty();
+    for (int i = 1; i < THREADS; i++)
+        rootPassed = rootPassed and rootMoves[i] == rootMoves[0];
+    std::cout << (rootPassed ? "PASSED" : "FAILED") << " syzygy root probe test (" << rootMoves[0].size() << " moves)" << std::endl;
+    syzygy::init("");
+}
+#endif
+
 int main() {
     std::cout << "Hello, World!" << std::endl;
 //    runAllMovesTests();
@@ -787,5 +981,12 @@ int main() {
 //    nullMoveTests();
 //    canTryNMPTests();
 //    stagedMovegenKiwipeteTest();
+//    cuckooTableTest();
+//    seeThresholdTests();
+//    fastPerftTests();
+//    packedBoardTests();
+//    bookMoveEncodingTests();
+//    bookKeyTests();
+//    syzygyProbeTests(); // needs -DFATHOM_DIR
     return 0;
 }
\ No newline at end of file
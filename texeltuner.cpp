@@ -0,0 +1,256 @@
+// Texel tuner for the HCE (the psts and mobility tables in hce.cpp)
+// Usage: ./amethyst_texel <positions.epd or positions.bin> [epochs] [threads] [learning rate]
+// EPD lines look like "<fen> [<result>]", and .bin files are packed positions (see packedboard.h)
+//
+// The eval is linear in its terms, so every position is stored once as a sparse list of (term, count) pairs.
+// Each epoch computes the gradient of the mean squared error between sigmoid(eval) and the result
+// on all positions, split between threads, and takes one Adam step.
+// When it is done, it prints the new tables in the same format as hce.cpp, so they can be pasted in.
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+#include "chessboard.h"
+#include "hce.h"
+#include "packedboard.h"
+
+constexpr int MAX_PHASE = 24;
+
+// All the positions, with their terms stored contiguously
+// The terms of position i are termCounts[firstTerm[i]] to termCounts[firstTerm[i + 1] - 1]
+struct Dataset {
+    std::vector<std::pair<int16_t, int16_t>> termCounts;
+    std::vector<size_t> firstTerm{0};
+    std::vector<float> mgWeights; // phase / 24
+    std::vector<float> results;
+
+    [[nodiscard]] size_t size() const {
+        return results.size();
+    }
+
+    void add(const ChessBoard& board, float result) {
+        const phase_t phase = hce::getTermCounts(board, termCounts);
+        firstTerm.push_back(termCounts.size());
+        mgWeights.push_back(float(phase) / MAX_PHASE);
+        results.push_back(result);
+    }
+};
+
+// The parameters are stored as mg values for every term, then eg values for every term
+constexpr int NUM_PARAMS = 2 * hce::NUM_TERMS;
+using Params = std::array<double, NUM_PARAMS>;
+
+// Calls body(threadIndex, begin, end) for one contiguous chunk of positions per thread
+template <typename Body>
+void parallelFor(size_t length, int threads, Body&& body) {
+    const size_t chunkSize = (length + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back(body, t, std::min(length, t * chunkSize), std::min(length, (t + 1) * chunkSize));
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+inline double getEval(const Dataset& data, size_t i, const Params& params) {
+    double mg = 0;
+    double eg = 0;
+    for (size_t j = data.firstTerm[i]; j < data.firstTerm[i + 1]; j++) {
+        const auto [term, count] = data.termCounts[j];
+        mg += params[term] * count;
+        eg += params[hce::NUM_TERMS + term] * count;
+    }
+    return mg * data.mgWeights[i] + eg * (1 - data.mgWeights[i]);
+}
+
+inline double sigmoid(double eval, double k) {
+    return 1 / (1 + std::exp(-k * eval / 400));
+}
+
+double getError(const Dataset& data, const Params& params, double k, int threads) {
+    std::vector<double> errors(threads, 0);
+    parallelFor(data.size(), threads, [&](int t, size_t begin, size_t end) {
+        double error = 0;
+        for (size_t i = begin; i < end; i++) {
+            const double difference = sigmoid(getEval(data, i, params), k) - data.results[i];
+            error += difference * difference;
+        }
+        errors[t] = error;
+    });
+    double error = 0;
+    for (double threadError : errors)
+        error += threadError;
+    return error / double(data.size());
+}
+
+// Finds the sigmoid scaling that fits the current eval best, with a ternary search
+double findK(const Dataset& data, const Params& params, int threads) {
+    double low = 0.1;
+    double high = 10;
+    for (int i = 0; i < 40; i++) {
+        const double mid1 = low + (high - low) / 3;
+        const double mid2 = high - (high - low) / 3;
+        if (getError(data, params, mid1, threads) < getError(data, params, mid2, threads))
+            high = mid2;
+        else
+            low = mid1;
+    }
+    return (low + high) / 2;
+}
+
+void getGradient(const Dataset& data, const Params& params, double k, int threads, Params& gradient) {
+    // Every thread adds up its own gradient, and then we add those up, so there is no locking
+    std::vector<Params> threadGradients(threads);
+    parallelFor(data.size(), threads, [&](int t, size_t begin, size_t end) {
+        Params& threadGradient = threadGradients[t];
+        threadGradient.fill(0);
+        for (size_t i = begin; i < end; i++) {
+            const double s = sigmoid(getEval(data, i, params), k);
+            const double outerGradient = (s - data.results[i]) * s * (1 - s);
+            const double mgGradient = outerGradient * data.mgWeights[i];
+            const double egGradient = outerGradient * (1 - data.mgWeights[i]);
+            for (size_t j = data.firstTerm[i]; j < data.firstTerm[i + 1]; j++) {
+                const auto [term, count] = data.termCounts[j];
+                threadGradient[term] += mgGradient * count;
+                threadGradient[hce::NUM_TERMS + term] += egGradient * count;
+            }
+        }
+    });
+
+    // The constant factors (2 from the square, and k / 400 from the sigmoid) are folded in here
+    const double scale = 2 * k / 400 / double(data.size());
+    gradient.fill(0);
+    for (const Params& threadGradient : threadGradients) {
+        for (int i = 0; i < NUM_PARAMS; i++)
+            gradient[i] += threadGradient[i] * scale;
+    }
+}
+
+bool loadDataset(const std::string& filename, Dataset& data) {
+    // Step 1: Packed positions
+    if (filename.ends_with(".bin")) {
+        const packed::Reader reader(filename);
+        if (!reader.isOpen())
+            return false;
+        for (const PackedBoard& packedBoard : reader)
+            data.add(ChessBoard::fromPacked(packedBoard), float(packedBoard.result) / 2);
+        return true;
+    }
+
+    // Step 2: EPD lines, like "<fen> [<result>]"
+    std::ifstream file(filename);
+    if (!file)
+        return false;
+    std::string line;
+    PackedBoard packedBoard{};
+    while (getline(file, line)) {
+        if (!line.empty() and packed::fromEPD(line, packedBoard))
+            data.add(ChessBoard::fromFEN(line.substr(0, line.find('['))), float(packedBoard.result) / 2);
+    }
+    return true;
+}
+
+void printS(const Params& params, int term, int width) {
+    std::cout << "S(" << std::setw(width) << std::lround(params[term]) << ","
+              << std::setw(width) << std::lround(params[hce::NUM_TERMS + term]) << ")";
+}
+
+// Prints the tables in the same layout as hce.cpp
+void printParams(const Params& params) {
+    std::cout << "    constexpr packed_eval_t mobility[6] = {";
+    for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+        printS(params, hce::NUM_PST_TERMS + piece, 3);
+        std::cout << (piece == pcs::KING ? "};" : ", ");
+    }
+    std::cout << std::endl << std::endl;
+
+    constexpr std::array<const char*, 2> BUCKET_NAMES = {"queenside", "kingside"};
+    std::cout << "    constexpr std::array<std::array<std::array<packed_eval_t, 64>, 6>, 2> psts = {{" << std::endl;
+    for (int bucket = 0; bucket < 2; bucket++) {
+        std::cout << "          {{" << std::endl;
+        std::cout << "                   // Friendly king on the " << BUCKET_NAMES[bucket] << std::endl;
+        for (piece_t piece = pcs::PAWN; piece <= pcs::KING; piece++) {
+            std::cout << "                   {" << std::endl;
+            for (int row = 0; row < 8; row++) {
+                std::cout << "                           ";
+                for (int column = 0; column < 8; column++) {
+                    printS(params, (bucket * 6 + piece) * 64 + row * 8 + column, 4);
+                    std::cout << (column == 7 ? "," : ", ");
+                }
+                std::cout << std::endl;
+            }
+            std::cout << "                   }," << std::endl;
+        } // end for loop over piece
+        std::cout << "           }}," << std::endl;
+    } // end for loop over bucket
+    std::cout << "        }};" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cout << "usage: amethyst_texel <positions.epd or positions.bin> [epochs] [threads] [learning rate]" << std::endl;
+        return 1;
+    }
+    const std::string filename = argv[1];
+    const int epochs = argc > 2 ? std::stoi(argv[2]) : 1000;
+    const int threads = std::max(1, argc > 3 ? std::stoi(argv[3]) : int(std::thread::hardware_concurrency()));
+    const double learningRate = argc > 4 ? std::stod(argv[4]) : 1;
+
+    // Step 1: Load the positions
+    auto start = std::chrono::steady_clock::now();
+    Dataset data;
+    if (!loadDataset(filename, data) or data.size() == 0) {
+        std::cout << "could not load any positions from " << filename << std::endl;
+        return 1;
+    }
+    const auto getElapsedSeconds = [&] {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+    std::cout << "loaded " << data.size() << " positions in " << getElapsedSeconds() << " s" << std::endl;
+
+    // Step 2: Start from the current eval, and fit the sigmoid to it
+    Params params{};
+    for (int term = 0; term < hce::NUM_TERMS; term++) {
+        const auto [mg, eg] = hce::getTerm(term);
+        params[term] = mg;
+        params[hce::NUM_TERMS + term] = eg;
+    }
+    const double k = findK(data, params, threads);
+    std::cout << "k = " << k << ", starting error = " << std::setprecision(8) << getError(data, params, k, threads) << std::endl;
+
+    // Step 3: Adam
+    constexpr double BETA1 = 0.9;
+    constexpr double BETA2 = 0.999;
+    constexpr double EPSILON = 1e-8;
+    Params gradient{};
+    Params momentum{};
+    Params velocity{};
+    start = std::chrono::steady_clock::now();
+    for (int epoch = 1; epoch <= epochs; epoch++) {
+        getGradient(data, params, k, threads, gradient);
+        const double momentumCorrection = 1 - std::pow(BETA1, epoch);
+        const double velocityCorrection = 1 - std::pow(BETA2, epoch);
+        for (int i = 0; i < NUM_PARAMS; i++) {
+            momentum[i] = BETA1 * momentum[i] + (1 - BETA1) * gradient[i];
+            velocity[i] = BETA2 * velocity[i] + (1 - BETA2) * gradient[i] * gradient[i];
+            params[i] -= learningRate * (momentum[i] / momentumCorrection) / (std::sqrt(velocity[i] / velocityCorrection) + EPSILON);
+        }
+
+        if (epoch % 100 == 0 or epoch == epochs) {
+            std::cout << "epoch " << epoch << " error " << getError(data, params, k, threads)
+                      << " (" << getElapsedSeconds() / epoch << " s per epoch)" << std::endl;
+        }
+    } // end for loop over epochs
+
+    // Step 4: Print the new tables
+    std::cout << std::endl;
+    printParams(params);
+    return 0;
+}
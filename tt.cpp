@@ -1,12 +1,18 @@
 #include "tt.h"
-#include "uciopt.h"
+#include "flags.h"
 
-TT::TT() {
-    table = std::vector<TTEntry>((uciopt::HASH << 20) / sizeof(TTEntry));
+#include <algorithm>
+
+TT::TT(const int hashMB) {
+    resize(hashMB);
+}
+
+void TT::resize(const int hashMB) {
+    table = std::vector<TTEntry>((size_t(hashMB) << 20) / sizeof(TTEntry));
 }
 
 void TT::clear() {
-    table = std::vector<TTEntry>((uciopt::HASH << 20) / sizeof(TTEntry));
+    std::fill(table.begin(), table.end(), TTEntry{});
 }
 
 TTEntry TT::get(const zobrist_t zobristCode) const {
@@ -20,8 +26,16 @@ TTEntry TT::get(const zobrist_t zobristCode) const {
 
 void TT::put(zobrist_t zobristCode, move_t ttMove, eval_t score, ttflag_t ttFlag, depth_t depth) {
     const size_t index = getIndex(zobristCode);
-    ttMove &= 0x3fffff;
+    ttMove = mvs::removeScore(ttMove);
     if (ttMove == 0 and zobristCode == table[index].zobristCode)
         ttMove = table[index].ttMove;
     table[getIndex(zobristCode)] = {zobristCode, ttMove, score, ttFlag, depth};
+}
+
+int TT::hashfull() const {
+    const size_t sampleSize = std::min<size_t>(1000, table.size());
+    int filled = 0;
+    for (size_t i = 0; i < sampleSize; i++)
+        filled += table[i].isNotNull();
+    return int(filled * 1000 / sampleSize);
 }
\ No newline at end of file
@@ -33,11 +33,17 @@ private:
     }
 
 public:
-    TT();
+    explicit TT(int hashMB);
+
+    // Changes the size of the TT to hashMB megabytes, which also clears it
+    void resize(int hashMB);
 
     void clear();
 
     [[nodiscard]] TTEntry get(zobrist_t zobristCode) const;
 
     void put(zobrist_t zobristCode, move_t ttMove, eval_t eval, ttflag_t ttFlag, depth_t depth);
+
+    // Estimates how full the TT is, in permill, by looking at the first 1000 entries
+    [[nodiscard]] int hashfull() const;
 };
\ No newline at end of file
@@ -5,19 +5,89 @@
 #include <sstream>
 #include <climits>
 #include <algorithm>
+#include <vector>
+#include <thread>
+#include <chrono>
 
 #include "searchglobals.h"
 #include "chessboard.h"
 #include "search.h"
 #include "bench.h"
+#include "datagen.h"
+#include "match.h"
+#include "evalbatch.h"
+#include "perft.h"
 #include "hce.h"
+#include "syzygy.h"
+#include "book.h"
 
 
+bool setOption(sg::SearchContext& context, const std::string& name, const std::string& value, const bool printConfirmation) {
+    // Spin options are clamped to their range, and left alone if the value isn't a number
+    const auto setSpinOption = [&](int& option, const int min, const int max) {
+        std::stringstream ss(value);
+        ss >> option;
+        option = std::clamp(option, min, max);
+        if (printConfirmation)
+            std::cout << "info string uci option " << name << " has been set to " << option << std::endl;
+    };
+
+    if (name == "Hash") {
+        setSpinOption(context.options.hash, uciopt::HASH_MIN, uciopt::HASH_MAX);
+        context.tt.resize(context.options.hash);
+    }
+    else if (name == "Threads")
+        setSpinOption(context.options.threads, uciopt::THREADS_MIN, uciopt::THREADS_MAX);
+    else if (name == "nodestime")
+        setSpinOption(context.options.nodestime, uciopt::NODESTIME_MIN, uciopt::NODESTIME_MAX);
+    else if (name == "SyzygyProbeDepth")
+        setSpinOption(context.options.syzygyProbeDepth, uciopt::SYZYGY_PROBE_DEPTH_MIN, uciopt::SYZYGY_PROBE_DEPTH_MAX);
+    else if (name == "SyzygyProbeLimit")
+        setSpinOption(context.options.syzygyProbeLimit, uciopt::SYZYGY_PROBE_LIMIT_MIN, uciopt::SYZYGY_PROBE_LIMIT_MAX);
+    else if (name == "SyzygyPath") {
+        uciopt::SYZYGY_PATH = value;
+        uciopt::SYZYGY_PATH.erase(0, uciopt::SYZYGY_PATH.find_first_not_of(' '));
+        syzygy::init(uciopt::SYZYGY_PATH);
+        if (printConfirmation)
+            std::cout << "info string uci option SyzygyPath has been set to " << uciopt::SYZYGY_PATH << std::endl;
+    }
+    else if (name == "Book") {
+        // The book is shared, so copies of this context (like the engines in a match) don't map it again
+        const std::string path = value.substr(std::min(value.find_first_not_of(' '), value.size()));
+        context.book = path.empty() or path == "<empty>" ? nullptr : std::make_shared<const book::Book>(path);
+        if (context.book != nullptr and !context.book->isOpen()) {
+            std::cout << "info string could not open book " << path << std::endl;
+            context.book = nullptr;
+        }
+        else if (printConfirmation) {
+            std::cout << "info string uci option Book has been set to " << (context.book ? path : "<empty>")
+                      << " (" << (context.book ? context.book->size() : 0) << " entries)" << std::endl;
+        }
+    }
+    else if (name == "OwnBook" or name == "BookBestMove") {
+        bool& option = name == "OwnBook" ? context.options.ownBook : context.options.bookBestMove;
+        option = value == "true";
+        if (printConfirmation)
+            std::cout << "info string uci option " << name << " has been set to " << (option ? "true" : "false") << std::endl;
+    }
+    else {
+        // The SPSA tunables, which only exist in tuning builds
+        const std::vector<uciopt::Tunable>& tunables = uciopt::getTunables();
+        const auto tunable = std::find_if(tunables.begin(), tunables.end(), [&](const uciopt::Tunable& t) { return t.name == name; });
+        if (tunable == tunables.end())
+            return false;
+        setSpinOption(context.options.tunables[tunable - tunables.begin()], tunable->min, tunable->max);
+    }
+    return true;
+}
+
 void uciLoop() {
     std::cout << "info string AMETHYST by Noah Holbrook" << std::endl;
 
     std::string command;
     ChessBoard position = ChessBoard::startpos();
+    sg::SearchContext context;
+    sg::SearchStats lastSearchStats; // printed by the stats command
 
     while (true) {
         getline(std::cin, command);
@@ -27,8 +97,16 @@ void uciLoop() {
             std::cout << "option name Hash type spin default " << uciopt::HASH_DEFAULT << " min " << uciopt::HASH_MIN << " max " << uciopt::HASH_MAX << std::endl;
             std::cout << "option name Threads type spin default " << uciopt::THREADS_DEFAULT << " min " << uciopt::THREADS_MIN << " max " << uciopt::THREADS_MAX << std::endl;
             std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+            std::cout << "option name SyzygyProbeDepth type spin default " << uciopt::SYZYGY_PROBE_DEPTH_DEFAULT << " min " << uciopt::SYZYGY_PROBE_DEPTH_MIN << " max " << uciopt::SYZYGY_PROBE_DEPTH_MAX << std::endl;
+            std::cout << "option name SyzygyProbeLimit type spin default " << uciopt::SYZYGY_PROBE_LIMIT_DEFAULT << " min " << uciopt::SYZYGY_PROBE_LIMIT_MIN << " max " << uciopt::SYZYGY_PROBE_LIMIT_MAX << std::endl;
+            std::cout << "option name Book type string default <empty>" << std::endl;
+            std::cout << "option name OwnBook type check default false" << std::endl;
+            std::cout << "option name BookBestMove type check default false" << std::endl;
             std::cout << "option name UCI_ShowWDL type check default false" << std::endl;
             std::cout << "option name Move Overhead type spin default 10 min 0 max 5000" << std::endl;
+            std::cout << "option name nodestime type spin default " << uciopt::NODESTIME_DEFAULT << " min " << uciopt::NODESTIME_MIN << " max " << uciopt::NODESTIME_MAX << std::endl;
+            for (const uciopt::Tunable& tunable : uciopt::getTunables())
+                std::cout << "option name " << tunable.name << " type spin default " << tunable.defaultValue << " min " << tunable.min << " max " << tunable.max << std::endl;
             std::cout << "uciok" << std::endl;
         }
 
@@ -36,36 +114,31 @@ void uciLoop() {
             std::cout << "readyok" << std::endl;
         }
 
-        else if (command == "ucinewgame") {
-            sg::GLOBAL_TT.clear();
+        else if (command == "spsa") {
+            // The tunables in the input format of OpenBench's SPSA tuner: name, type, value, min, max, step, learning rate
+            const std::vector<uciopt::Tunable>& tunables = uciopt::getTunables();
+            for (size_t i = 0; i < tunables.size(); i++) {
+                std::cout << tunables[i].name << ", int, " << context.options.tunables[i] << ", " << tunables[i].min << ", "
+                          << tunables[i].max << ", " << tunables[i].step << ", 0.002" << std::endl;
+            }
         }
 
-        else if (command.starts_with("setoption")) {
-            if (command.starts_with("setoption name Hash value")) {
-                std::stringstream ss(command);
-                std::string word;
-                for (int i = 0; i < 4; i++)
-                    ss >> word;
-                ss >> uciopt::HASH;
-                uciopt::HASH = std::clamp(uciopt::HASH, uciopt::HASH_MIN, uciopt::HASH_MAX);
-                std::cout << "info string uci option Hash has been set to " << uciopt::HASH << std::endl;
-            }
+        else if (command == "ucinewgame") {
+            context.tt.clear();
+        }
 
-            if (command.starts_with("setoption name Threads value")) {
-                std::stringstream ss(command);
-                std::string word;
-                for (int i = 0; i < 4; i++)
-                    ss >> word;
-                ss >> uciopt::THREADS;
-                uciopt::THREADS = std::clamp(uciopt::THREADS, uciopt::THREADS_MIN, uciopt::THREADS_MAX);
-                std::cout << "info string uci option Threads has been set to " << uciopt::THREADS << std::endl;
-            }
+        else if (command.starts_with("setoption name ")) {
+            // setoption name <name> value <value>, where both the name and the value can contain spaces
+            const size_t nameStart = std::string("setoption name ").size();
+            const size_t valuePosition = command.find(" value ");
+            if (valuePosition != std::string::npos)
+                setOption(context, command.substr(nameStart, valuePosition - nameStart), command.substr(valuePosition + 7), true);
         }
 
         else if (command.starts_with("position")) {
             // Step 1: Clear the repetition tables
-            sg::repetitionTables[sides::WHITE].clear();
-            sg::repetitionTables[sides::BLACK].clear();
+            context.repetitionTables[sides::WHITE].clear();
+            context.repetitionTables[sides::BLACK].clear();
 
             // Step 2: Initialize needed variables
             std::stringstream ss(command);
@@ -78,11 +151,11 @@ void uciLoop() {
                 if (parsingMoves) {
                     move_t move = position.parseLANMove(word);
                     if (mvs::isIrreversible(move)) {
-                        sg::repetitionTables[sides::WHITE].clear();
-                        sg::repetitionTables[sides::BLACK].clear();
+                        context.repetitionTables[sides::WHITE].clear();
+                        context.repetitionTables[sides::BLACK].clear();
                     }
                     else {
-                        sg::repetitionTables[position.getSTM()].insert(position.getZobristCode());
+                        context.repetitionTables[position.getSTM()].insert(position.getZobristCode());
                     }
                     position.makemove(move);
                 }
@@ -105,18 +178,44 @@ void uciLoop() {
 
             // Step 4: Add the last position to the repetition table
             // We do this because when parsing moves, the position BEFORE the move was made was added to the repetition table
-            sg::repetitionTables[position.getSTM()].insert(position.getZobristCode());
+            context.repetitionTables[position.getSTM()].insert(position.getZobristCode());
         } // end if command starts with position
 
+        else if (command.starts_with("go perft")) {
+            // go perft <depth> [threads]
+            // This uses every core by default, since it is for testing move generation and not for playing
+            std::stringstream ss(command);
+            std::string word;
+            int depth = 1;
+            int threads = int(std::max(1u, std::thread::hardware_concurrency()));
+            ss >> word >> word >> depth >> threads;
+            depth = std::clamp(depth, 0, 100);
+            threads = std::max(threads, 1);
+
+            const auto start = std::chrono::steady_clock::now();
+            const perft_t nodes = fastPerft(position, depth_t(depth), threads, context.options.hash, true);
+            const int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+            std::cout << std::endl << "Nodes searched: " << nodes << std::endl;
+            std::cout << "info string perft(" << depth << ") took " << ms << " ms with " << threads << " threads, "
+                      << nodes * 1000 / std::max(ms, int64_t(1)) << " nps" << std::endl;
+        } // end if command starts with go perft
+
         else if (command.starts_with("go")) {
+            // Play from the book without searching if we can
+            if (context.options.ownBook and context.book != nullptr) {
+                const move_t bookMove = context.book->probe(position, context.options.bookBestMove);
+                if (bookMove != 0) {
+                    std::cout << "bestmove " << moveToLAN(bookMove) << std::endl;
+                    continue;
+                }
+            }
+
             int wtime = 0;
             int btime = 0;
             int winc = 0;
             int binc = 0;
             int movestogo = 0;
-            sg::depthLimit = 100;
-            sg::nodesLimit = INT64_MAX;
-            int mate = 0;
+            context.limits = sg::SearchLimits();
             int movetime = -1;
             std::stringstream ss(command);
             std::string word;
@@ -132,18 +231,22 @@ void uciLoop() {
                 else if (word == "movestogo")
                     ss >> movestogo;
                 else if (word == "depth") {
-                    ss >> sg::depthLimit;
-                    sg::depthLimit = std::clamp(sg::depthLimit, 1, 100);
-                    sg::nodesLimit = INT64_MAX;
+                    ss >> context.limits.depthLimit;
+                    context.limits.depthLimit = std::clamp(context.limits.depthLimit, 1, 100);
+                    context.limits.nodesLimit = INT64_MAX;
+                    context.limits.hardNodesLimit = INT64_MAX;
                     movetime = 1000000000;
                 }
                 else if (word == "nodes") {
-                    ss >> sg::nodesLimit;
-                    sg::depthLimit = 100;
+                    ss >> context.limits.nodesLimit;
+                    context.limits.hardNodesLimit = context.limits.nodesLimit;
+                    context.limits.depthLimit = 100;
+                    movetime = 1000000000;
+                }
+                else if (word == "mate") {
+                    ss >> context.limits.mateLimit;
                     movetime = 1000000000;
                 }
-                else if (word == "mate")
-                    ss >> mate;
                 else if (word == "movetime")
                     ss >> movetime;
                 else if (word == "infinite")
@@ -151,19 +254,16 @@ void uciLoop() {
             } // end while ss >> word
 
             if (movetime >= 0) {
-                sg::softTimeLimit = movetime;
-                sg::hardTimeLimit = movetime;
-            }
-            else if (position.getSTM() == sides::WHITE) {
-                sg::softTimeLimit = spsa::calcSoftTimeLimit(wtime, winc);
-                sg::hardTimeLimit = spsa::calcHardTimeLimit(wtime, winc);
+                context.limits.softTimeLimit = movetime;
+                context.limits.hardTimeLimit = movetime;
             }
             else {
-                sg::softTimeLimit = spsa::calcSoftTimeLimit(btime, binc);
-                sg::hardTimeLimit = spsa::calcHardTimeLimit(btime, binc);
+                const int time = position.getSTM() == sides::WHITE ? wtime : btime;
+                const int inc = position.getSTM() == sides::WHITE ? winc : binc;
+                context.setClockLimits(time, inc);
             }
 
-            rootSearch(position);
+            lastSearchStats = rootSearch(context, position).stats;
 
         } // end if command starts with go
 
@@ -171,8 +271,48 @@ void uciLoop() {
             std::cout << hce::getStaticEval(position) << std::endl;
         }
 
-        else if (command == "bench") {
-            bench();
+        else if (command == "stats") {
+            lastSearchStats.print();
+        }
+
+        else if (command == "bench" or command.starts_with("bench ")) {
+            std::stringstream ss(command);
+            std::string word;
+            std::vector<std::string> args;
+            ss >> word; // this is just "bench"
+            while (ss >> word)
+                args.push_back(word);
+            runBenchCommand(args);
+        }
+
+        else if (command.starts_with("datagen ")) {
+            std::stringstream ss(command);
+            std::string word;
+            std::vector<std::string> args;
+            ss >> word; // this is just "datagen"
+            while (ss >> word)
+                args.push_back(word);
+            runDatagenCommand(args, context.options);
+        }
+
+        else if (command.starts_with("match ")) {
+            std::stringstream ss(command);
+            std::string word;
+            std::vector<std::string> args;
+            ss >> word; // this is just "match"
+            while (ss >> word)
+                args.push_back(word);
+            runMatchCommand(args, context.options);
+        }
+
+        else if (command.starts_with("evalbatch ")) {
+            std::stringstream ss(command);
+            std::string word;
+            std::vector<std::string> args;
+            ss >> word; // this is just "evalbatch"
+            while (ss >> word)
+                args.push_back(word);
+            runEvalBatchCommand(args, context.options);
         }
 
         else if (command == "quit") {
@@ -1,3 +1,12 @@
 #pragma once
 
-void uciLoop();
\ No newline at end of file
+#include <string>
+
+#include "searchglobals.h"
+
+void uciLoop();
+
+// Sets the UCI option with the given name in context, like "setoption name <name> value <value>" does
+// This is also used to give each engine in a match its own options (see match.cpp)
+// Returns false if there is no option with that name
+bool setOption(sg::SearchContext& context, const std::string& name, const std::string& value, bool printConfirmation);
@@ -1,6 +1,32 @@
 #include "uciopt.h"
 
 namespace uciopt {
-    int HASH = HASH_DEFAULT;
-    int THREADS = THREADS_DEFAULT;
-}
\ No newline at end of file
+    std::string SYZYGY_PATH = "<empty>";
+
+    // This is a function so that it exists before the tunables in other files register themselves
+    static std::vector<Tunable>& getMutableTunables() {
+        static std::vector<Tunable> tunables;
+        return tunables;
+    }
+
+    bool registerTunable(const Tunable& tunable) {
+        getMutableTunables().push_back(tunable);
+        return true;
+    }
+
+    const std::vector<Tunable>& getTunables() {
+        return getMutableTunables();
+    }
+
+    std::vector<int> getTunableDefaults() {
+        std::vector<int> defaults;
+        for (const Tunable& tunable : getTunables())
+            defaults.push_back(tunable.defaultValue);
+        return defaults;
+    }
+
+    void applyTunables(const Options& options) {
+        for (size_t i = 0; i < options.tunables.size(); i++)
+            getTunables()[i].get() = options.tunables[i];
+    }
+}
@@ -1,13 +1,85 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
+// The ranges and defaults of the UCI options
+// The values live in an Options struct, so that every engine (see sg::SearchContext) can have its own
 namespace uciopt {
     constexpr int HASH_MIN = 1;
     constexpr int HASH_DEFAULT = 16;
     constexpr int HASH_MAX = 1024;
-    extern int HASH;
 
     constexpr int THREADS_MIN = 1;
     constexpr int THREADS_DEFAULT = 1;
     constexpr int THREADS_MAX = 1;
-    extern int THREADS;
-}
\ No newline at end of file
+
+    // When this is nonzero, the clock is interpreted as a node budget of NODESTIME nodes per millisecond
+    constexpr int NODESTIME_MIN = 0;
+    constexpr int NODESTIME_DEFAULT = 0;
+    constexpr int NODESTIME_MAX = 10000;
+
+    // Syzygy tablebases are only probed in positions with at most SyzygyProbeLimit pieces,
+    // and only at depth SyzygyProbeDepth or higher unless there are fewer pieces than that
+    // SYZYGY_PATH is the only option that is shared by every engine, since the tablebases are loaded once for the whole process
+    extern std::string SYZYGY_PATH;
+
+    constexpr int SYZYGY_PROBE_DEPTH_MIN = 1;
+    constexpr int SYZYGY_PROBE_DEPTH_DEFAULT = 1;
+    constexpr int SYZYGY_PROBE_DEPTH_MAX = 100;
+
+    constexpr int SYZYGY_PROBE_LIMIT_MIN = 0;
+    constexpr int SYZYGY_PROBE_LIMIT_DEFAULT = 7;
+    constexpr int SYZYGY_PROBE_LIMIT_MAX = 7;
+
+    // A search parameter that SPSA can tune, see SPSA_PARAM below
+    struct Tunable {
+        const char* name;
+        int& (*get)(); // gets this thread's value
+        int defaultValue;
+        int min;
+        int max;
+        int step;
+    };
+
+    // Adds a tunable to the list that the uci and setoption commands use. Always returns true
+    bool registerTunable(const Tunable& tunable);
+
+    // Gets every tunable, which is empty unless this is a tuning build
+    const std::vector<Tunable>& getTunables();
+
+    // Gets the default value of every tunable, in the same order as getTunables()
+    std::vector<int> getTunableDefaults();
+
+    // The UCI options of one engine, except SyzygyPath
+
+    struct Options {
+        int hash = HASH_DEFAULT;
+        int threads = THREADS_DEFAULT;
+        int nodestime = NODESTIME_DEFAULT;
+        int syzygyProbeDepth = SYZYGY_PROBE_DEPTH_DEFAULT;
+        int syzygyProbeLimit = SYZYGY_PROBE_LIMIT_DEFAULT;
+        bool ownBook = false;      // play from the book (see SearchContext::book) instead of searching when we can
+        bool bookBestMove = false; // play the book move with the highest weight, instead of a weighted random one
+        std::vector<int> tunables = getTunableDefaults(); // in the same order as getTunables()
+    };
+
+    // Sets this thread's tunables to the values in options
+    // rootSearch does this, so the search always uses the tunables of the engine that is searching
+    void applyTunables(const Options& options);
+}
+
+// Declares a search parameter called NAME
+// In tuning builds (configure with -DSPSA_TUNING=ON), this is a UCI spin option, so SPSA can set it with setoption
+// The value is thread_local, and is set from the options of the engine that is searching (see applyTunables),
+// so every engine in a match can have its own value
+// In release builds, this is just a constexpr, so it costs nothing at runtime
+#ifdef SPSA_TUNING
+#define SPSA_PARAM(NAME, DEFAULT, MIN, MAX, STEP) \
+    inline thread_local int NAME = DEFAULT; \
+    inline int& get##NAME() { return NAME; } \
+    inline const bool NAME##_REGISTERED = uciopt::registerTunable({#NAME, get##NAME, DEFAULT, MIN, MAX, STEP});
+#else
+#define SPSA_PARAM(NAME, DEFAULT, MIN, MAX, STEP) \
+    constexpr int NAME = DEFAULT;
+#endif